@@ -1,5 +1,24 @@
 #pragma once
 
+#include <type_traits>
 #include <vector>
+
+template<typename T>
+using ArrayList = std::vector<T>;
+
+namespace klib
+{
+namespace priv
+{
+// Elements that can be copied as raw bytes, with no copy constructor or destructor to run.
+// vector<bool> is packed bits, so it never qualifies.
 template<typename T>
-using ArrayList = std::vector<T>;
\ No newline at end of file
+struct IsBulkCopyable : std::integral_constant<bool,
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 5
+	__has_trivial_copy(T) // No std::is_trivially_copyable before libstdc++ 5
+#else
+	std::is_trivially_copyable<T>::value
+#endif
+	&& !std::is_same<T, bool>::value> {};
+}
+}
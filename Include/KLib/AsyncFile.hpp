@@ -0,0 +1,336 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+
+#include <KLib/Config.hpp>
+#include <KLib/ArrayList.hpp>
+#include <KLib/LinkedList.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/File.hpp>
+
+// io_uring is used straight through its syscalls, only the kernel headers are needed
+#if defined(__linux__) && !defined(KL_NO_IO_URING) && defined(__has_include)
+#	if __has_include(<linux/io_uring.h>)
+#		define KL_IO_URING
+#	endif
+#endif
+
+namespace klib
+{
+namespace io
+{
+
+enum IOOperation
+{
+	IO_READ,
+	IO_WRITE
+};
+
+enum IOBackend
+{
+	IO_BACKEND_URING, // Linux io_uring, requests go straight to the kernel
+	IO_BACKEND_THREADS // Worker threads doing blocking positional reads and writes
+};
+
+class AsyncFile;
+
+struct API_EXPORT IOResult
+{
+	IOOperation operation;
+	AsyncFile* file;
+	ULong offset;
+	char* buffer;
+	UInt size; // Bytes requested
+	Long bytes; // Bytes transferred, -1 on error
+	Int error; // errno or GetLastError() if the request failed
+	ULong submitted; // Nanoseconds since the unix epoch
+	ULong completed;
+
+	inline bool IsSuccess() const
+	{
+		return bytes >= 0;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Time from submission to completion
+	///
+	/// Includes time spent queued behind other requests.
+	///
+	/// \return Nanoseconds
+	///
+	///////////////////////////////////////////////////////////
+	inline ULong GetLatency() const
+	{
+		return ( completed > submitted ) ? completed - submitted : 0;
+	}
+};
+
+typedef std::function<void(const IOResult&)> IOCallback;
+
+struct API_EXPORT IORequest
+{
+	IORequest()
+		: operation(IO_READ), file(nullptr), offset(0), buffer(nullptr), size(0) {}
+
+	IORequest(IOOperation operation, AsyncFile& file, ULong offset, char* buffer, UInt size, IOCallback callback = IOCallback())
+		: operation(operation), file(&file), offset(offset), buffer(buffer), size(size), callback(std::move(callback)) {}
+
+	IOOperation operation;
+	AsyncFile* file;
+	ULong offset;
+	char* buffer; // Must stay valid until the request completes
+	UInt size;
+	IOCallback callback; // Optional
+};
+
+class API_EXPORT AsyncFile
+{
+public:
+	AsyncFile();
+
+	///////////////////////////////////////////////////////////
+	/// \brief 'Attempt-Open' Constructor
+	///
+	/// Use IsOpen() to check if the file was opened.
+	///
+	/// \param path File to open
+	/// \param mode Read, Write or Overwrite; writable files are created if missing
+	///
+	///////////////////////////////////////////////////////////
+	AsyncFile(const String& path, FileMode mode = FileModes::Read);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Default Destructor
+	///
+	/// Closes the file. Requests using it must have completed.
+	///
+	///////////////////////////////////////////////////////////
+	~AsyncFile(void);
+
+	AsyncFile(const AsyncFile&) = delete;
+	AsyncFile& operator=(const AsyncFile&) = delete;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Open a file for asynchronous IO
+	///
+	/// There is no file pointer: every request carries its own
+	/// offset, so any number may be in flight at once.
+	///
+	/// \param path File to open
+	/// \param mode Read, Write or Overwrite; writable files are created if missing
+	///
+	/// \return True if the file was opened
+	///
+	///////////////////////////////////////////////////////////
+	bool Open(const String& path, FileMode mode = FileModes::Read);
+
+	void Close();
+
+	inline bool IsOpen() const
+	{
+		return mOpen;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the size of the file
+	///
+	/// \return Size in bytes, from the file's metadata
+	///
+	///////////////////////////////////////////////////////////
+	ULong GetSize() const;
+
+	inline FileMode GetMode() const
+	{
+		return mMode;
+	}
+
+	inline const String& GetPath() const
+	{
+		return mPath;
+	}
+
+	inline NativeFileHandle GetHandle() const
+	{
+		return mHandle;
+	}
+
+private:
+	bool mOpen;
+	FileMode mMode;
+	String mPath;
+	NativeFileHandle mHandle;
+};
+///////////////////////////////////////////////////////////
+/// \class AsyncFile
+/// \brief File handle for use with an IOQueue
+/// \ingroup FileIO
+///
+/// Unlike BinaryFile it has no read or write functions of
+/// its own, requests are made through an IOQueue.
+///
+/// \see IOQueue
+///
+///////////////////////////////////////////////////////////
+
+namespace priv
+{
+struct IOOperationState;
+class IOEngine;
+}
+
+class API_EXPORT IOQueue
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// Uses io_uring if the kernel allows it, otherwise starts
+	/// the worker threads.
+	///
+	/// \param queueDepth Most requests in flight at once, Submit() blocks beyond it
+	/// \param threads Worker threads for the fallback, 0 for one per core (at most queueDepth)
+	///
+	///////////////////////////////////////////////////////////
+	IOQueue(UInt queueDepth = 64, UInt threads = 0);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Default Destructor
+	///
+	/// Waits for every request in flight to complete.
+	///
+	///////////////////////////////////////////////////////////
+	~IOQueue(void);
+
+	IOQueue(const IOQueue&) = delete;
+	IOQueue& operator=(const IOQueue&) = delete;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Submit a batch of requests
+	///
+	/// Handed to the kernel together, with io_uring in a
+	/// single syscall. Blocks while the queue is full.
+	/// Callbacks run on an IO thread once each request
+	/// completes, in any order, so they should be short.
+	/// A callback may submit a follow-up request, the
+	/// completed request's slot is freed before it runs.
+	///
+	/// \param requests Requests to start
+	/// \param count Number of requests
+	///
+	///////////////////////////////////////////////////////////
+	void Submit(const IORequest* requests, UInt count);
+
+	inline void Submit(const IORequest& request)
+	{
+		Submit(&request, 1);
+	}
+
+	inline void Submit(const ArrayList<IORequest>& requests)
+	{
+		Submit(requests.data(), static_cast<UInt>( requests.size() ));
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Start a read and get a future for its result
+	///
+	/// \param file File to read from
+	/// \param offset Position in the file
+	/// \param buffer Destination, must stay valid until the read completes
+	/// \param size Bytes to read
+	///
+	/// \return Result, bytes may be less than size at the end of the file
+	///
+	///////////////////////////////////////////////////////////
+	std::future<IOResult> Read(AsyncFile& file, ULong offset, char* buffer, UInt size);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Start a write and get a future for its result
+	///
+	/// \param file File to write to
+	/// \param offset Position in the file
+	/// \param data Source, must stay valid until the write completes
+	/// \param size Bytes to write
+	///
+	/// \return Result
+	///
+	///////////////////////////////////////////////////////////
+	std::future<IOResult> Write(AsyncFile& file, ULong offset, const char* data, UInt size);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Block until every request in flight completes
+	///
+	/// Also waits for their callbacks to return.
+	///
+	///////////////////////////////////////////////////////////
+	void Wait();
+
+	inline IOBackend GetBackend() const
+	{
+		return mBackend;
+	}
+
+	inline UInt GetQueueDepth() const
+	{
+		return mQueueDepth;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the number of requests in flight
+	///
+	///////////////////////////////////////////////////////////
+	UInt GetPending() const;
+
+private:
+	friend class priv::IOEngine;
+
+	void Complete(priv::IOOperationState* state, Long bytes, Int error);
+
+	UInt mQueueDepth;
+	IOBackend mBackend;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mCondition; // Signals a completed request
+	UInt mPending;
+	UInt mCompleting; // Callbacks still running
+
+	priv::IOEngine* mpEngine;
+};
+///////////////////////////////////////////////////////////
+/// \class IOQueue
+/// \brief Runs file reads and writes without blocking the caller
+/// \ingroup FileIO
+///
+/// On Linux requests go through io_uring: one syscall
+/// submits a whole batch and the kernel completes them
+/// without a thread per request. Elsewhere, or when the
+/// kernel refuses io_uring, a pool of worker threads does
+/// blocking positional IO instead. Either way the caller
+/// only pays for queueing the request.
+///
+/// Every result carries submission and completion times
+/// (CycleClock), so IO latency can be measured per request.
+///
+/// \code
+/// IOQueue queue(32);
+/// AsyncFile file("level1.pak");
+/// ArrayList<IORequest> batch;
+/// for (Chunk& chunk : chunks)
+///     batch.push_back(IORequest(IO_READ, file, chunk.offset, chunk.data, chunk.size,
+///         [](const IOResult& result) { OnChunkLoaded(result); }));
+/// queue.Submit(batch);
+///
+/// std::future<IOResult> header = queue.Read(file, 0, headerBuffer, sizeof(headerBuffer));
+/// ...
+/// if (header.get().IsSuccess()) ...
+/// \endcode
+///
+/// \see AsyncFile
+///
+///////////////////////////////////////////////////////////
+
+} // io
+} // klib
@@ -0,0 +1,423 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+#include <KLib/Config.hpp>
+#include <KLib/ArrayList.hpp>
+#include <KLib/Map.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/NonCopyable.hpp>
+#include <KLib/Logging.hpp>
+#include <KLib/Time.hpp>
+
+namespace klib
+{
+
+namespace io
+{
+class BinaryFile; // Forward declaration
+}
+
+namespace logging
+{
+
+///////////////////////////////////////////////////////////
+/// Binary log file layout
+///
+/// Header: "KLBL" magic, UInt version.
+/// Followed by chunks: Byte type, UInt size, 'size' bytes.
+///
+/// BINARY_CHUNK_FORMAT: UInt id, UInt line,
+///     UInt length + format, function and file strings,
+///     Byte argument count, one BinaryArgType per argument.
+/// BINARY_CHUNK_RECORDS: records from one thread's buffer,
+///     each UInt id, Byte level, ULong timestamp, then the raw arguments
+///     (strings are UInt length + characters).
+///
+///////////////////////////////////////////////////////////
+enum BinaryChunkType : Byte
+{
+	BINARY_CHUNK_FORMAT		= 1,
+	BINARY_CHUNK_RECORDS	= 2
+};
+
+enum BinaryArgType : Byte
+{
+	BINARY_ARG_BOOL		= 0,
+	BINARY_ARG_CHAR		= 1,
+	BINARY_ARG_INT32	= 2,
+	BINARY_ARG_UINT32	= 3,
+	BINARY_ARG_INT64	= 4,
+	BINARY_ARG_UINT64	= 5,
+	BINARY_ARG_FLOAT	= 6,
+	BINARY_ARG_DOUBLE	= 7,
+	BINARY_ARG_STRING	= 8
+};
+
+const UInt BinaryLogVersion = 2;
+
+///////////////////////////////////////////////////////////
+/// \brief Static description of one KL_BINLOG call site
+///
+/// Created once per call site by the macro, 'id' is
+/// assigned the first time the site logs.
+///
+///////////////////////////////////////////////////////////
+struct BinaryLogSite
+{
+	BinaryLogSite(const char* siteFunction, const char* siteFile, UInt siteLine)
+		: function(siteFunction), file(siteFile), line(siteLine), id(0) {}
+
+	const char* function;
+	const char* file;
+	UInt line;
+	std::atomic<UInt> id;
+};
+
+namespace priv
+{
+
+struct BinaryLogBuffer
+{
+	std::mutex mutex;
+	ArrayList<char> data;
+	size_t used;
+};
+
+// Maps an argument type onto how it's stored in the log
+template<typename T, typename Enable = void>
+struct BinaryArg; // Unsupported argument type
+
+template<>
+struct BinaryArg<bool>
+{
+	static const BinaryArgType type = BINARY_ARG_BOOL;
+	static size_t Size(bool) { return 1; }
+	static void Encode(char*& out, bool value) { *out++ = value ? 1 : 0; }
+};
+
+template<>
+struct BinaryArg<char>
+{
+	static const BinaryArgType type = BINARY_ARG_CHAR;
+	static size_t Size(char) { return 1; }
+	static void Encode(char*& out, char value) { *out++ = value; }
+};
+
+template<typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type>
+{
+	// Everything narrower than 32 bits is widened, 64-bit values keep their size
+	typedef typename std::conditional<sizeof(T) <= 4,
+		typename std::conditional<std::is_signed<T>::value, Int, UInt>::type,
+		typename std::conditional<std::is_signed<T>::value, Long, ULong>::type>::type StoredType;
+
+	static const BinaryArgType type = sizeof(T) <= 4
+		? ( std::is_signed<T>::value ? BINARY_ARG_INT32 : BINARY_ARG_UINT32 )
+		: ( std::is_signed<T>::value ? BINARY_ARG_INT64 : BINARY_ARG_UINT64 );
+
+	static size_t Size(T) { return sizeof(StoredType); }
+	static void Encode(char*& out, T value)
+	{
+		StoredType stored = static_cast<StoredType>( value );
+		std::memcpy(out, &stored, sizeof(StoredType));
+		out += sizeof(StoredType);
+	}
+};
+
+template<>
+struct BinaryArg<Float>
+{
+	static const BinaryArgType type = BINARY_ARG_FLOAT;
+	static size_t Size(Float) { return sizeof(Float); }
+	static void Encode(char*& out, Float value) { std::memcpy(out, &value, sizeof(Float)); out += sizeof(Float); }
+};
+
+template<>
+struct BinaryArg<Double>
+{
+	static const BinaryArgType type = BINARY_ARG_DOUBLE;
+	static size_t Size(Double) { return sizeof(Double); }
+	static void Encode(char*& out, Double value) { std::memcpy(out, &value, sizeof(Double)); out += sizeof(Double); }
+};
+
+inline void EncodeString(char*& out, const char* data, UInt length)
+{
+	std::memcpy(out, &length, sizeof(UInt));
+	std::memcpy(out + sizeof(UInt), data, length);
+	out += sizeof(UInt) + length;
+}
+
+template<>
+struct BinaryArg<const char*>
+{
+	static const BinaryArgType type = BINARY_ARG_STRING;
+	static size_t Size(const char* value) { return sizeof(UInt) + ( value ? std::strlen(value) : 0 ); }
+	static void Encode(char*& out, const char* value) { EncodeString(out, value, value ? static_cast<UInt>( std::strlen(value) ) : 0); }
+};
+
+template<>
+struct BinaryArg<char*> : BinaryArg<const char*> {};
+
+template<>
+struct BinaryArg<String>
+{
+	static const BinaryArgType type = BINARY_ARG_STRING;
+	static size_t Size(const String& value) { return sizeof(UInt) + value.size(); }
+	static void Encode(char*& out, const String& value) { EncodeString(out, value.data(), static_cast<UInt>( value.size() )); }
+};
+
+// Arrays (string literals) decay to pointers
+template<typename T>
+struct BinaryArgOf : BinaryArg<typename std::decay<T>::type> {};
+
+inline size_t ArgumentsSize() { return 0; }
+
+template<typename T, typename... Args>
+inline size_t ArgumentsSize(const T& value, const Args&... args)
+{
+	return BinaryArgOf<T>::Size(value) + ArgumentsSize(args...);
+}
+
+inline void EncodeArguments(char*&) {}
+
+template<typename T, typename... Args>
+inline void EncodeArguments(char*& out, const T& value, const Args&... args)
+{
+	BinaryArgOf<T>::Encode(out, value);
+	EncodeArguments(out, args...);
+}
+
+} // priv
+
+class API_EXPORT BinaryLogger : NonCopyable
+{
+public:
+	BinaryLogger();
+	~BinaryLogger();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Start logging into a file
+	///
+	/// Overwrites the file, then writes the header and the
+	/// descriptors of every call site seen so far.
+	///
+	/// \param path Path to the binary log
+	/// \param bufferSize Bytes buffered per thread before they are written out
+	///
+	/// \return File opened successfully
+	///
+	///////////////////////////////////////////////////////////
+	bool Open(const String& path, UInt bufferSize = 64 * 1024);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Flush every thread's buffer and close the file
+	///
+	///////////////////////////////////////////////////////////
+	void Close();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write every thread's buffered records to the file
+	///
+	///////////////////////////////////////////////////////////
+	void Flush();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check if entries of a level would be logged
+	///
+	/// \param level Level to check
+	///
+	/// \return True if open and level is at or above the threshold
+	///
+	///////////////////////////////////////////////////////////
+	inline bool IsEnabled(LogLevel level) const
+	{
+		return static_cast<Byte>( level ) >= mLevel.load(std::memory_order_relaxed) &&
+			mOpen.load(std::memory_order_relaxed);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Set the runtime threshold
+	///
+	/// \param level Lowest level to log
+	///
+	///////////////////////////////////////////////////////////
+	inline void SetLevel(LogLevel level)
+	{
+		mLevel.store(static_cast<Byte>( level ), std::memory_order_relaxed);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Log a record for a call site
+	///
+	/// Copies the site id, the level, a timestamp and the raw
+	/// argument bytes into the calling thread's buffer, no formatting
+	/// is done. The format is decoded offline by BinaryLogReader.
+	///
+	/// Use KL_BINLOG rather than calling this directly.
+	///
+	/// \param site Static descriptor of the call site
+	/// \param level Severity, stored per record since it may differ between calls
+	/// \param format Format string, "{}" marks each argument
+	/// \param args Arguments: bool, char, integers, floats, strings
+	///
+	///////////////////////////////////////////////////////////
+	template<typename... Args>
+	inline void Write(BinaryLogSite& site, LogLevel level, const char* format, const Args&... args)
+	{
+		UInt id = site.id.load(std::memory_order_acquire);
+		if (id == 0)
+		{
+			const Byte types[] = { priv::BinaryArgOf<Args>::type..., 0 };
+			id = Register(site, format, types, sizeof...(Args));
+		}
+
+		ULong timestamp = time::GetCurrentTime<time::nanoseconds>();
+		size_t size = sizeof(UInt) + sizeof(Byte) + sizeof(ULong) + priv::ArgumentsSize(args...);
+
+		priv::BinaryLogBuffer& buffer = GetThreadBuffer();
+		std::lock_guard<std::mutex> lock(buffer.mutex);
+
+		char* out = Reserve(buffer, size);
+		std::memcpy(out, &id, sizeof(UInt));
+		out[sizeof(UInt)] = static_cast<char>( level );
+		std::memcpy(out + sizeof(UInt) + sizeof(Byte), &timestamp, sizeof(ULong));
+		out += sizeof(UInt) + sizeof(Byte) + sizeof(ULong);
+		priv::EncodeArguments(out, args...);
+	}
+
+private:
+	UInt Register(BinaryLogSite& site, const char* format, const Byte* types, UInt typeCount);
+	void WriteFormat(UInt index);
+	void WriteChunk(BinaryChunkType type, const char* data, UInt size);
+	void FlushBuffer(priv::BinaryLogBuffer& buffer);
+	char* Reserve(priv::BinaryLogBuffer& buffer, size_t size);
+	priv::BinaryLogBuffer& GetThreadBuffer();
+
+	struct Format
+	{
+		BinaryLogSite* site;
+		String format;
+		ArrayList<Byte> types;
+	};
+
+	std::atomic<bool> mOpen;
+	std::atomic<Byte> mLevel;
+	UInt mBufferSize;
+
+	std::mutex mFileMutex; // Guards the file and the formats
+	io::BinaryFile* mpFile;
+	ArrayList<Format> mFormats;
+
+	std::mutex mBuffersMutex;
+	Map<ULong, priv::BinaryLogBuffer*> mBuffers; // Keyed by hashed thread id
+};
+///////////////////////////////////////////////////////////
+/// \class BinaryLogger
+/// \brief Deferred-formatting binary logger
+///
+/// Moves the formatting cost of logging off the calling
+/// thread: each call site registers its format string
+/// once, after that a log call only copies an id, a
+/// timestamp and the raw argument bytes into a per-thread
+/// buffer. Buffers are written out in large chunks.
+///
+/// The KLib-LogDecoder tool (or BinaryLogReader) turns the
+/// file back into the LogEntry::ToString text format.
+///
+/// Records are grouped per flushed buffer, so entries from
+/// different threads are only ordered within their thread.
+///
+/// \code
+/// klib::DefaultBinaryLogger.Open("game.klbl");
+/// KL_BINLOG(klib::logging::INFO_LOG, "Loaded {} in {}ms", name, elapsed);
+/// \endcode
+///
+/// \see BinaryLogReader, KL_BINLOG
+///
+///////////////////////////////////////////////////////////
+
+class API_EXPORT BinaryLogReader : NonCopyable
+{
+public:
+	BinaryLogReader();
+	~BinaryLogReader();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Open a binary log
+	///
+	/// \param path Path to a file written by BinaryLogger
+	///
+	/// \return True if the file was opened and has a valid header
+	///
+	///////////////////////////////////////////////////////////
+	bool Open(const String& path);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Decode the next record
+	///
+	/// Formats the record's arguments into its format string
+	/// and fills in the source information of its call site.
+	///
+	/// \param entry Entry to decode into
+	///
+	/// \return False at the end of the file or on corrupt data
+	///
+	///////////////////////////////////////////////////////////
+	bool Next(LogEntry& entry);
+
+private:
+	bool ReadChunk();
+	bool ReadFormat();
+
+	struct Format
+	{
+		UInt line;
+		String format;
+		String function;
+		String file;
+		ArrayList<Byte> types;
+		SourceLocation source; // Points into function and file
+	};
+
+	io::BinaryFile* mpFile;
+	Map<UInt, Format> mFormats;
+	ArrayList<char> mChunk;
+	size_t mChunkPosition;
+};
+///////////////////////////////////////////////////////////
+/// \class BinaryLogReader
+/// \brief Decodes files written by BinaryLogger
+///
+/// \code
+/// BinaryLogReader reader;
+/// LogEntry entry;
+/// if (reader.Open("game.klbl"))
+///     while (reader.Next(entry))
+///         std::cout << entry.ToString() << std::endl;
+/// \endcode
+///
+///////////////////////////////////////////////////////////
+
+} // logging
+
+extern API_EXPORT logging::BinaryLogger DefaultBinaryLogger;
+
+} // klib
+
+#define KL_BINLOG(level, ...) \
+do \
+{ \
+	klib::logging::LogLevel l(level); \
+	if (l >= KL_LOG_MIN_LEVEL && KL_LOG_UNLIKELY(klib::DefaultBinaryLogger.IsEnabled(l))) \
+	{ \
+		static klib::logging::BinaryLogSite site(__FUNCTION__, __FILE__, __LINE__); \
+		klib::DefaultBinaryLogger.Write(site, l, __VA_ARGS__); \
+	} \
+} \
+while (0) \
+
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <type_traits>
+#include <utility> // std::move
 
 #include <KLib/Config.hpp>
 #include <KLib/ArrayList.hpp>
@@ -10,6 +14,7 @@
 #include <KLib/ISerializable.hpp>
 #include <KLib/ByteBuffer.hpp> // ByteBuffer, buffering for String
 #include <KLib/File.hpp>
+#include <KLib/MappedFile.hpp>
 
 namespace klib
 {
@@ -31,6 +36,7 @@ public:
 	///
 	///////////////////////////////////////////////////////////
 	BinaryStream()
+		: mStream(nullptr), mpFile(nullptr), mMode(0), mpMemory(nullptr), mpWritableMemory(nullptr), mMemorySize(0), mPosition(0), mFailed(true)
 	{
 		KL_ERROR("BinaryStream initialized wrong");
 	}
@@ -42,9 +48,9 @@ public:
 	///
 	///////////////////////////////////////////////////////////
 	BinaryStream(std::iostream* baseStream)
+		: mStream(baseStream), mpFile(nullptr), mMode(io::FileModes::Read | io::FileModes::Write),
+		mpMemory(nullptr), mpWritableMemory(nullptr), mMemorySize(0), mPosition(0), mFailed(false)
 	{
-		mStream = baseStream;
-		mMode = ( io::FileModes::Read | io::FileModes::Write );
 	}
 
 	///////////////////////////////////////////////////////////
@@ -57,9 +63,29 @@ public:
 	///
 	///////////////////////////////////////////////////////////
 	BinaryStream(BinaryFile& file)
+		: mStream(&file.GetStream()), mpFile(&file), mMode(file.GetMode()),
+		mpMemory(nullptr), mpWritableMemory(nullptr), mMemorySize(0), mPosition(0), mFailed(false)
 	{
-		mStream = &file.GetStream();
-		mMode = file.GetMode();
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief MappedFile Constructor
+	///
+	/// Reads straight from the mapping: no syscalls, and
+	/// ReadView() hands out pointers into it without copying.
+	/// Writable unless the mapping is ReadOnly; writes can't
+	/// go past the end of the mapping.
+	///
+	/// The file must stay open while the stream is used.
+	///
+	///////////////////////////////////////////////////////////
+	BinaryStream(MappedFile& file)
+		: mStream(nullptr), mpFile(nullptr), mMode(io::FileModes::Read),
+		mpMemory(file.GetData()), mpWritableMemory(file.GetWritableData()),
+		mMemorySize(file.GetSize()), mPosition(0), mFailed(!file.IsOpen())
+	{
+		if (mpWritableMemory)
+			mMode |= io::FileModes::Write;
 	}
 
 	///////////////////////////////////////////////////////////
@@ -73,18 +99,24 @@ public:
 	///////////////////////////////////////////////////////////
 	/// \brief Get the size of the stream
 	///
-	/// This function may be expensive if called over and over again,
-	/// so if you need this value multiple times, store it.
+	/// Free for MappedFile and BinaryFile streams, which know
+	/// their size. Other streams seek to the end and back, so
+	/// if you need this value multiple times, store it.
 	///
 	/// \return stream size in bytes
 	///
 	///////////////////////////////////////////////////////////
-	inline UInt GetSize()
+	inline ULong GetSize()
 	{
 		KL_ASSERT(( mMode & io::FileModes::Read ) > 0);
-		UInt pos = Tell(); // store current pos to restore
+		if (IsMemory())
+			return mMemorySize;
+		if (mpFile)
+			return mpFile->GetSize(); // Cached by the file
+
+		ULong pos = Tell(); // store current pos to restore
 		Seek(0, std::ios::end); // go to end of file
-		UInt length = Tell(); // retrieve pos at end
+		ULong length = Tell(); // retrieve pos at end
 		Seek(pos); // restore last position
 		return length;
 	}
@@ -111,7 +143,7 @@ public:
 	///////////////////////////////////////////////////////////
 	inline bool IsHealthy() const
 	{
-		return mStream->rdstate() == std::ios::goodbit;
+		return IsMemory() ? !mFailed : mStream->rdstate() == std::ios::goodbit;
 	}
 
 	///////////////////////////////////////////////////////////
@@ -123,9 +155,12 @@ public:
 	/// \return stream healthy
 	///
 	///////////////////////////////////////////////////////////
-	inline bool Seek(UInt pos, std::ios::seekdir way = std::ios::beg)
+	inline bool Seek(ULong pos, std::ios::seekdir way = std::ios::beg)
 	{
-		mStream->seekg(pos, way);
+		if (IsMemory())
+			return SeekMemory(( way == std::ios::cur ) ? mPosition : ( way == std::ios::end ) ? mMemorySize : 0, static_cast<Long>( pos ));
+
+		mStream->seekg(static_cast<std::streamoff>( pos ), way);
 		return IsHealthy();
 	}
 
@@ -137,9 +172,12 @@ public:
 	/// \return stream healthy
 	///
 	///////////////////////////////////////////////////////////
-	inline bool Skip(Int amount)
+	inline bool Skip(Long amount)
 	{
-		mStream->seekg(amount, std::ios_base::cur);
+		if (IsMemory())
+			return SeekMemory(mPosition, amount);
+
+		mStream->seekg(static_cast<std::streamoff>( amount ), std::ios_base::cur);
 		return IsHealthy();
 	}
 
@@ -149,9 +187,9 @@ public:
 	/// \return Position of pointer
 	///
 	///////////////////////////////////////////////////////////
-	inline UInt Tell() const
+	inline ULong Tell() const
 	{
-		return mStream->tellg();
+		return IsMemory() ? mPosition : static_cast<ULong>( static_cast<std::streamoff>( mStream->tellg() ) );
 	}
 
 	///////////////////////////////////////////////////////////
@@ -166,8 +204,11 @@ public:
 	inline bool IsEnd() const
 	{
 		KL_ASSERT(( mMode & io::FileModes::Read ) > 0);
+		if (IsMemory())
+			return mPosition >= mMemorySize;
+
 		return ( mStream->rdstate() == std::ios::eofbit ) ||
-			( Tell() == (UInt)(mStream->end) );
+			( mpFile && Tell() >= mpFile->GetSize() );
 	}
 	
 	////////////////////////////////////////////////////////////
@@ -224,10 +265,43 @@ public:
 	inline bool Read(char* buffer, UInt bytes)
 	{
 		KL_ASSERT(( mMode & io::FileModes::Read ) > 0);
+		if (IsMemory())
+		{
+			const char* data = ReadView(bytes);
+			if (data)
+				std::memcpy(buffer, data, bytes);
+			return data != nullptr;
+		}
+
 		mStream->read(buffer, bytes);
 		return IsHealthy();
 	}
 
+	///////////////////////////////////////////////////////////
+	/// \brief Read raw bytes without copying them
+	///
+	/// Only for streams over a MappedFile: returns a pointer
+	/// into the mapping and moves past the bytes. The pointer
+	/// stays valid while the file is mapped.
+	///
+	/// \param bytes Number of bytes to read
+	///
+	/// \return First byte, null if there aren't enough bytes left or the stream isn't mapped
+	///
+	///////////////////////////////////////////////////////////
+	inline const char* ReadView(UInt bytes)
+	{
+		if (!IsMemory() || mFailed || mMemorySize - mPosition < bytes)
+		{
+			mFailed = true;
+			return nullptr;
+		}
+
+		const char* data = mpMemory + mPosition;
+		mPosition += bytes;
+		return data;
+	}
+
 	///////////////////////////////////////////////////////////
 	/// \brief Write raw bytes
 	///
@@ -243,10 +317,85 @@ public:
 	inline bool Write(const char* data, UInt bytes)
 	{
 		KL_ASSERT(( mMode & io::FileModes::Write ) > 0);
+		if (IsMemory())
+		{
+			if (!mpWritableMemory || mFailed || mMemorySize - mPosition < bytes)
+			{
+				mFailed = true;
+				return false;
+			}
+
+			std::memcpy(mpWritableMemory + mPosition, data, bytes);
+			mPosition += bytes;
+			return true;
+		}
+
 		mStream->write(data, bytes);
 		return IsHealthy();
 	}
 
+	///////////////////////////////////////////////////////////
+	/// \brief Write several buffers as one record
+	///
+	/// Streams made from a BinaryFile gather them into a
+	/// single vectored write, see BinaryFile::WriteV. Other
+	/// streams write the segments in turn.
+	///
+	/// \code
+	/// UInt nameLength = name.size();
+	/// stream.WriteV({ header, nameLength, name, payload });
+	/// \endcode
+	///
+	/// \param segments Buffers to write, in order
+	/// \param count Number of segments
+	///
+	/// \return success
+	///
+	///////////////////////////////////////////////////////////
+	inline bool WriteV(const IOSegment* segments, UInt count)
+	{
+		if (mpFile)
+			return mpFile->WriteV(segments, count);
+
+		for (UInt i = 0; i < count; i++)
+			if (!Write(segments[i].data, static_cast<UInt>( segments[i].size )))
+				return false;
+		return true;
+	}
+
+	inline bool WriteV(std::initializer_list<IOSegment> segments)
+	{
+		return WriteV(segments.begin(), static_cast<UInt>( segments.size() ));
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read into several buffers at once
+	///
+	/// The counterpart of WriteV, a single vectored read for
+	/// streams made from a BinaryFile.
+	///
+	/// \param segments Buffers to fill, in order
+	/// \param count Number of segments
+	///
+	/// \return success, false if the stream ends before every segment is full
+	///
+	///////////////////////////////////////////////////////////
+	inline bool ReadV(const IOSegment* segments, UInt count)
+	{
+		if (mpFile)
+			return mpFile->ReadV(segments, count);
+
+		for (UInt i = 0; i < count; i++)
+			if (!Read(segments[i].data, static_cast<UInt>( segments[i].size )))
+				return false;
+		return true;
+	}
+
+	inline bool ReadV(std::initializer_list<IOSegment> segments)
+	{
+		return ReadV(segments.begin(), static_cast<UInt>( segments.size() ));
+	}
+
 	///////////////////////////////////////////////////////////
 	/// \brief Read from stream
 	///
@@ -302,11 +451,42 @@ public:
 		return *this;
 	}
 
+	///////////////////////////////////////////////////////////
+	/// \brief Read an ArrayList
+	///
+	/// The array is sized once from the length prefix. Arrays
+	/// of basic types and plain structs are then read as one
+	/// block; others, e.g. of Strings or nested arrays, an
+	/// element at a time.
+	///
+	///////////////////////////////////////////////////////////
+	template<typename T>
+	inline BinaryStream& operator>>(ArrayList<T>& data)
+	{
+		// Make sure we can read
+		KL_ASSERT((mMode & io::FileModes::Read) > 0);
+
+		UInt length = 0;
+		*this >> length;
+
+		data.clear();
+
+		// Every element takes at least a byte, so a corrupt length can't make us allocate gigabytes
+		if (!IsHealthy() || !HasBytesLeft(static_cast<ULong>( length ) * ( klib::priv::IsBulkCopyable<T>::value ? sizeof(T) : 1 )))
+		{
+			Fail();
+			return *this;
+		}
+
+		ReadElements(data, length, klib::priv::IsBulkCopyable<T>());
+		return *this;
+	}
+
 	template<typename T = ByteBuffer>
 	inline BinaryStream& operator>>(ByteBuffer& data)
 	{
 		// Make sure we can write
-		KL_ASSERT( mMode & io::FileModes::Read) > 0);
+		KL_ASSERT(( mMode & io::FileModes::Read ) > 0);
 
 		// First extract data length
 		UInt length = 0;
@@ -417,6 +597,24 @@ public:
 		return *this;
 	}
 
+	///////////////////////////////////////////////////////////
+	/// \brief Write an ArrayList
+	///
+	/// A UInt length, then the elements: one block for basic
+	/// types and plain structs, one at a time otherwise.
+	///
+	///////////////////////////////////////////////////////////
+	template<typename T>
+	inline BinaryStream& operator<<(const ArrayList<T>& data)
+	{
+		// Make sure we can write
+		KL_ASSERT((mMode & io::FileModes::Write) > 0);
+
+		*this << static_cast<UInt>( data.size() );
+		WriteElements(data, klib::priv::IsBulkCopyable<T>());
+		return *this;
+	}
+
 	template<typename T = ByteBuffer>
 	inline BinaryStream& operator<<(const ByteBuffer& data)
 	{
@@ -467,9 +665,120 @@ public:
 		return *this;
 	}
 
+	///////////////////////////////////////////////////////////
+	/// \brief Check if the stream reads from memory
+	///
+	/// \return True if made from a MappedFile
+	///
+	///////////////////////////////////////////////////////////
+	inline bool IsMemory() const
+	{
+		return mStream == nullptr;
+	}
+
 protected:
-	std::iostream* mStream;
-	std::ios::openmode mMode;
+	// False only if the stream is known to end sooner, streams of unknown size are trusted
+	inline bool HasBytesLeft(ULong bytes)
+	{
+		if (IsMemory())
+			return bytes <= mMemorySize - mPosition;
+		if (mpFile)
+		{
+			ULong size = mpFile->GetSize();
+			ULong position = Tell();
+			return position <= size && bytes <= size - position;
+		}
+		return true;
+	}
+
+	inline void Fail()
+	{
+		if (IsMemory())
+			mFailed = true;
+		else
+			mStream->setstate(std::ios::failbit);
+	}
+
+	// Read() and Write() take a UInt, so blocks over 4GB go in pieces
+	inline bool ReadBlock(char* data, ULong bytes)
+	{
+		for (UInt chunk; bytes > 0; data += chunk, bytes -= chunk)
+		{
+			chunk = static_cast<UInt>( std::min<ULong>(bytes, 1 << 30) );
+			if (!Read(data, chunk))
+				return false;
+		}
+		return true;
+	}
+
+	inline bool WriteBlock(const char* data, ULong bytes)
+	{
+		for (UInt chunk; bytes > 0; data += chunk, bytes -= chunk)
+		{
+			chunk = static_cast<UInt>( std::min<ULong>(bytes, 1 << 30) );
+			if (!Write(data, chunk))
+				return false;
+		}
+		return true;
+	}
+
+	template<typename T>
+	inline void ReadElements(ArrayList<T>& data, UInt length, std::true_type)
+	{
+		data.resize(length);
+		if (length > 0 && !ReadBlock(reinterpret_cast<char*>( data.data() ), static_cast<ULong>( length ) * sizeof(T)))
+			data.clear();
+	}
+
+	template<typename T>
+	inline void ReadElements(ArrayList<T>& data, UInt length, std::false_type)
+	{
+		data.reserve(length);
+		for (UInt i = 0; i < length && IsHealthy(); i++)
+		{
+			T value;
+			*this >> value;
+			data.push_back(std::move(value));
+		}
+	}
+
+	template<typename T>
+	inline void WriteElements(const ArrayList<T>& data, std::true_type)
+	{
+		if (!data.empty())
+			WriteBlock(reinterpret_cast<const char*>( data.data() ), static_cast<ULong>( data.size() ) * sizeof(T));
+	}
+
+	template<typename T>
+	inline void WriteElements(const ArrayList<T>& data, std::false_type)
+	{
+		for (const T& value : data)
+			*this << value;
+	}
+
+	inline bool SeekMemory(ULong base, Long offset)
+	{
+		Long position = static_cast<Long>( base ) + offset;
+		if (position < 0 || static_cast<ULong>( position ) > mMemorySize)
+		{
+			mFailed = true;
+			return false;
+		}
+
+		mPosition = static_cast<ULong>( position );
+		mFailed = false; // Seeking clears the failure, like clear() + seekg() would
+		return true;
+	}
+
+	std::iostream* mStream; // Null when reading from memory
+	BinaryFile* mpFile; // Null unless made from a BinaryFile, which caches the size
+	FileMode mMode;
+
+	const char* mpMemory;
+	char* mpWritableMemory; // Null unless the mapping is writable
+	ULong mMemorySize;
+	ULong mPosition;
+	bool mFailed;
 };
 
 ///////////////////////////////////////////////////////////
@@ -501,7 +810,7 @@ protected:
 /// stream << String("hello binary");
 /// \endcode
 ///
-/// \see BinaryFile, ISerializable
+/// \see BinaryFile, ISerializable, BasicMemoryStream
 ///
 ///////////////////////////////////////////////////////////
 
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstring>
+
+#include <KLib/Config.hpp>
+#include <KLib/ArrayList.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/StringView.hpp>
+#include <KLib/File.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+enum NewlinePolicy
+{
+	NEWLINE_LF, // "\n"
+	NEWLINE_CRLF, // "\r\n"
+	NEWLINE_NATIVE // CRLF on Windows, LF elsewhere
+};
+
+class API_EXPORT BufferedWriter
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// Writes at the file's current position. Newlines are
+	/// written exactly as the policy says only if the file
+	/// was opened with FileModes::Binary; a text mode stream
+	/// turns every "\n" into "\r\n" on Windows.
+	///
+	/// \param file File open for output, must outlive the writer
+	/// \param bufferSize Bytes collected before writing to the file
+	/// \param newline Line ending used by WriteLine() and NewLine()
+	///
+	///////////////////////////////////////////////////////////
+	BufferedWriter(FileBase& file, UInt bufferSize = 1024 * 1024, NewlinePolicy newline = NEWLINE_LF);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Default Destructor
+	///
+	/// Flushes whatever is still buffered.
+	///
+	///////////////////////////////////////////////////////////
+	~BufferedWriter(void);
+
+	BufferedWriter(const BufferedWriter&) = delete;
+	BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write raw bytes
+	///
+	/// A copy into the buffer unless it is full; data bigger
+	/// than the buffer goes to the file directly.
+	///
+	/// \param data Bytes to write
+	/// \param size Number of bytes
+	///
+	/// \return False if writing to the file failed
+	///
+	///////////////////////////////////////////////////////////
+	inline bool Write(const char* data, size_t size)
+	{
+		if (size <= mBuffer.size() - mUsed)
+		{
+			std::memcpy(mBuffer.data() + mUsed, data, size);
+			mUsed += size;
+			return mHealthy;
+		}
+		return WriteThrough(data, size);
+	}
+
+	inline bool Write(const StringView& text)
+	{
+		return Write(text.data(), text.size());
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write a line
+	///
+	/// \param text Line, without a line ending
+	///
+	/// \return False if writing to the file failed
+	///
+	///////////////////////////////////////////////////////////
+	inline bool WriteLine(const StringView& text)
+	{
+		Write(text.data(), text.size());
+		return NewLine();
+	}
+
+	inline bool NewLine()
+	{
+		return Write(mNewline, mNewlineSize);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write the buffer to the file and flush it
+	///
+	/// \return False if writing to the file failed
+	///
+	///////////////////////////////////////////////////////////
+	bool Flush();
+
+	inline bool IsHealthy() const
+	{
+		return mHealthy;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the total number of bytes written
+	///
+	/// \return Bytes written, including those still buffered
+	///
+	///////////////////////////////////////////////////////////
+	inline ULong GetBytesWritten() const
+	{
+		return mFlushed + mUsed;
+	}
+
+private:
+	bool WriteThrough(const char* data, size_t size);
+	bool WriteBuffer();
+
+	FileBase& mFile;
+	ArrayList<char> mBuffer;
+	size_t mUsed;
+	ULong mFlushed; // Bytes handed to the file
+	char mNewline[2];
+	UInt mNewlineSize;
+	bool mHealthy;
+};
+///////////////////////////////////////////////////////////
+/// \class BufferedWriter
+/// \brief Collects small writes into large ones
+/// \ingroup FileIO
+///
+/// Every TextFile::Write() goes through the stream's
+/// formatting and locale machinery. The writer only copies
+/// each record into a large buffer and hands the stream one
+/// big block when it fills, so writing millions of short
+/// records runs close to the speed of the disk.
+///
+/// \code
+/// BinaryFile file("positions.csv", FileModes::Overwrite);
+/// BufferedWriter writer(file, 4 * 1024 * 1024, NEWLINE_CRLF);
+/// for (const Sample& sample : samples)
+///     writer.WriteLine(sample.ToCsv());
+/// writer.Flush();
+/// \endcode
+///
+/// \see TextFile, BinaryFile
+///
+///////////////////////////////////////////////////////////
+
+} // io
+} // klib
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstring>
+#include <utility> // std::swap
+
 #include <KLib/Config.hpp>
 #include <KLib/Number.hpp>
 
@@ -25,6 +28,28 @@ public:
 		mSize = bytes;
 	}
 
+	// Copies own their bytes, so a buffer can be assigned and returned without freeing it twice
+	ByteBuffer(const ByteBuffer& other)
+		: mData(new char[other.mSize]), mSize(other.mSize)
+	{
+		if (mSize > 0)
+			std::memcpy(mData, other.mData, static_cast<size_t>( mSize ));
+	}
+
+	ByteBuffer(ByteBuffer&& other)
+		: mData(other.mData), mSize(other.mSize)
+	{
+		other.mData = nullptr;
+		other.mSize = 0;
+	}
+
+	ByteBuffer& operator=(ByteBuffer other)
+	{
+		std::swap(mData, other.mData);
+		std::swap(mSize, other.mSize);
+		return *this;
+	}
+
 	///////////////////////////////////////////////////////////
 	/// \brief Default Destructor
 	///
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstdio>
+
+#include <KLib/Config.hpp>
+#include <KLib/ArrayList.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/NonCopyable.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+///////////////////////////////////////////////////////////
+/// \brief Worst case compressed size of a block
+///
+/// \param size Uncompressed size
+///
+/// \return Bytes CompressBlock may need
+///
+///////////////////////////////////////////////////////////
+inline UInt GetCompressBound(UInt size)
+{
+	return size + size / 255 + 16;
+}
+
+///////////////////////////////////////////////////////////
+/// \brief Compress a block
+///
+/// Produces an LZ4 block: runs of literals followed by
+/// matches of at least 4 bytes within the last 64KB.
+/// Greedy single-probe matching, so it runs at hundreds of
+/// MB/s and log text still shrinks several times.
+///
+/// \param source Bytes to compress
+/// \param size Number of bytes
+/// \param destination Output, GetCompressBound(size) bytes is always enough
+/// \param capacity Size of the output
+///
+/// \return Compressed size, 0 if it didn't fit
+///
+///////////////////////////////////////////////////////////
+API_EXPORT UInt CompressBlock(const char* source, UInt size, char* destination, UInt capacity);
+
+///////////////////////////////////////////////////////////
+/// \brief Decompress a block made by CompressBlock
+///
+/// Every length and offset is checked, corrupt input fails
+/// instead of reading or writing out of bounds.
+///
+/// \param source Compressed bytes
+/// \param size Number of compressed bytes
+/// \param destination Output
+/// \param capacity Size of the output
+///
+/// \return Decompressed size, -1 if the block is corrupt or too big
+///
+///////////////////////////////////////////////////////////
+API_EXPORT Int DecompressBlock(const char* source, UInt size, char* destination, UInt capacity);
+
+class API_EXPORT CompressedWriter : NonCopyable
+{
+public:
+	CompressedWriter();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Default Destructor
+	///
+	/// Closes the frame if it is still open.
+	///
+	///////////////////////////////////////////////////////////
+	~CompressedWriter(void);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Create a compressed file
+	///
+	/// \param path File to create or overwrite
+	/// \param blockSize Bytes compressed at once, also what a reader buffers
+	///
+	/// \return True if the file could be created
+	///
+	///////////////////////////////////////////////////////////
+	bool Open(const String& path, UInt blockSize = 256 * 1024);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Append data
+	///
+	/// Buffered, a block is compressed and written each time
+	/// the buffer fills up.
+	///
+	/// \param data Bytes to write
+	/// \param size Number of bytes
+	///
+	/// \return False if writing to the file failed
+	///
+	///////////////////////////////////////////////////////////
+	bool Write(const char* data, size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write the last block and the end marker
+	///
+	/// \return False if writing to the file failed
+	///
+	///////////////////////////////////////////////////////////
+	bool Close();
+
+	inline bool IsOpen() const
+	{
+		return mpFile != nullptr;
+	}
+
+private:
+	bool WriteBlock();
+
+	std::FILE* mpFile;
+	UInt mBlockSize;
+	ArrayList<char> mBlock;
+	ArrayList<char> mCompressed;
+	bool mFailed;
+};
+///////////////////////////////////////////////////////////
+/// \class CompressedWriter
+/// \brief Writes a stream of compressed blocks to a file
+///
+/// Frame format, host byte order:
+///     "KLZ1", UInt block size
+///     blocks: UInt header, data
+///         header bits 0-30 are the data size, bit 31 set
+///         if the block is stored uncompressed
+///     UInt 0 ends the frame
+///
+/// Blocks are independent, so memory use is bounded by the
+/// block size on both ends.
+///
+/// \see CompressedReader
+///
+///////////////////////////////////////////////////////////
+
+class API_EXPORT CompressedReader : NonCopyable
+{
+public:
+	CompressedReader();
+
+	~CompressedReader(void);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Open a file written by CompressedWriter
+	///
+	/// \param path File to read
+	///
+	/// \return False if the file can't be opened or isn't a frame
+	///
+	///////////////////////////////////////////////////////////
+	bool Open(const String& path);
+
+	void Close();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read decompressed bytes
+	///
+	/// Decompresses one block at a time as it is needed.
+	///
+	/// \param data Output
+	/// \param size Bytes wanted
+	///
+	/// \return Bytes read, less than 'size' at the end of the data
+	///
+	///////////////////////////////////////////////////////////
+	size_t Read(char* data, size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read up to the next newline
+	///
+	/// \param line Set to the line, without the newline
+	///
+	/// \return False at the end of the data
+	///
+	///////////////////////////////////////////////////////////
+	bool ReadLine(String& line);
+
+	inline bool IsOpen() const
+	{
+		return mpFile != nullptr;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check if the frame was cut short or corrupt
+	///
+	/// \return True if reading stopped before the end marker
+	///
+	///////////////////////////////////////////////////////////
+	inline bool IsCorrupt() const
+	{
+		return mCorrupt;
+	}
+
+private:
+	bool ReadBlock();
+
+	std::FILE* mpFile;
+	ArrayList<char> mBlock;
+	ArrayList<char> mCompressed;
+	size_t mPosition; // Next unread byte of mBlock
+	size_t mSize; // Decompressed bytes in mBlock
+	bool mEnded;
+	bool mCorrupt;
+};
+///////////////////////////////////////////////////////////
+/// \class CompressedReader
+/// \brief Streams the contents of a compressed file
+///
+/// Only one block is in memory at a time, however big the
+/// file is.
+///
+/// \code
+/// CompressedReader reader;
+/// reader.Open("server.log.3.klz");
+/// String line;
+/// while (reader.ReadLine(line))
+///     Process(line);
+/// \endcode
+///
+/// \see CompressedWriter
+///
+///////////////////////////////////////////////////////////
+
+} // io
+} // klib
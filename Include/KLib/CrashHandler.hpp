@@ -0,0 +1,83 @@
+#pragma once
+
+#include <KLib/Config.hpp>
+#include <KLib/Memory.hpp>
+#include <KLib/String.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+class FlightRecorder; // Forward declaration
+
+class API_EXPORT CrashHandler
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Install handlers for SIGSEGV, SIGABRT and SIGFPE
+	///
+	/// When one of the signals is raised, the recorder is
+	/// dumped to 'dumpPath' and the signal is raised again
+	/// with the default action, so the program still
+	/// terminates (and core dumps) as it normally would.
+	///
+	/// Installing again replaces the recorder and path.
+	/// Also calls InstallThread() for the calling thread.
+	///
+	/// \param recorder Recorder to dump, kept alive by the handler
+	/// \param dumpPath File the entries are written to on a crash
+	///
+	/// \return True if the handlers were installed
+	///
+	///////////////////////////////////////////////////////////
+	static bool Install(StrongPtr<FlightRecorder> recorder, const String& dumpPath);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Let the handler run when this thread overflows its stack
+	///
+	/// A stack overflow leaves no room to run the handler, so
+	/// it runs on an alternate stack instead. The kernel keeps
+	/// one per thread: call this at the start of every thread
+	/// whose crashes should be dumped. Without it, a stack
+	/// overflow on that thread kills the program without a
+	/// dump; other crashes are still handled.
+	///
+	/// The stack is freed when the thread exits. Does nothing
+	/// on Windows.
+	///
+	/// \return True if the thread has an alternate stack
+	///
+	///////////////////////////////////////////////////////////
+	static bool InstallThread();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Restore the default signal actions
+	///
+	///////////////////////////////////////////////////////////
+	static void Uninstall();
+};
+///////////////////////////////////////////////////////////
+/// \class CrashHandler
+/// \brief Dumps a FlightRecorder when the program crashes
+///
+/// Everything done inside the signal handler is
+/// async-signal-safe: the path is copied up front and the
+/// dump only uses open() and write().
+///
+/// \code
+/// CrashHandler::Install(recorder, "crash.log");
+///
+/// void* Worker::Run()
+/// {
+///     CrashHandler::InstallThread();
+///     ...
+/// }
+/// \endcode
+///
+/// \see FlightRecorder
+///
+///////////////////////////////////////////////////////////
+
+} // logging
+} // klib
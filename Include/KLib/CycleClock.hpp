@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#if defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+#	include <intrin.h>
+#	define KL_CYCLE_COUNTER_X86
+#elif defined(__x86_64__) || defined(__i386__)
+#	include <x86intrin.h>
+#	define KL_CYCLE_COUNTER_X86
+#elif defined(__aarch64__)
+#	define KL_CYCLE_COUNTER_ARM64
+#endif
+
+#include <KLib/Config.hpp>
+#include <KLib/Number.hpp>
+
+namespace klib
+{
+namespace time
+{
+
+class API_EXPORT CycleClock
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Read the cycle counter
+	///
+	/// A handful of cycles on x86 and ARM64; other targets
+	/// fall back to steady_clock. Ticks are only comparable
+	/// on the same machine and mean nothing until converted.
+	///
+	/// \return Current tick count
+	///
+	///////////////////////////////////////////////////////////
+	static inline ULong Now()
+	{
+#if defined(KL_CYCLE_COUNTER_X86)
+		return __rdtsc();
+#elif defined(KL_CYCLE_COUNTER_ARM64)
+		ULong ticks;
+		asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+		return ticks;
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Measure the tick rate against the system clock
+	///
+	/// Blocks for a couple of milliseconds the first time;
+	/// later calls refine the rate over the whole time since
+	/// then and return straight away. Called by Logger when
+	/// it is switched to the cycle counter.
+	///
+	///////////////////////////////////////////////////////////
+	static void Calibrate();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Recalibrate if the last calibration is a second old
+	///
+	/// Cheap enough to call once per batch of entries, only a
+	/// counter read and a compare unless it is due.
+	///
+	///////////////////////////////////////////////////////////
+	static inline void Update()
+	{
+		ULong next = mNextCalibration.load(std::memory_order_relaxed);
+		if (next != 0 && static_cast<Long>( Now() - next ) >= 0)
+			Calibrate();
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Convert ticks to nanoseconds since the unix epoch
+	///
+	/// Uses the latest calibration. Lock-free and
+	/// async-signal-safe, FlightRecorder uses it while
+	/// dumping from a signal handler.
+	///
+	/// \param ticks Value previously returned by Now()
+	///
+	/// \return Time in nanoseconds, 0 if never calibrated
+	///
+	///////////////////////////////////////////////////////////
+	static ULong ToNanoseconds(ULong ticks);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check if Calibrate() has been called
+	///
+	/// \return True if ticks can be converted
+	///
+	///////////////////////////////////////////////////////////
+	static inline bool IsCalibrated()
+	{
+		return mNextCalibration.load(std::memory_order_relaxed) != 0;
+	}
+
+private:
+	static std::atomic<ULong> mNextCalibration; // Tick count after which Update() recalibrates, 0 before the first calibration
+};
+///////////////////////////////////////////////////////////
+/// \class CycleClock
+/// \brief Timestamps from the CPU cycle counter
+///
+/// Reading the counter is an order of magnitude cheaper
+/// than asking the system clock, so hot paths store raw
+/// ticks and leave the conversion to whoever formats them.
+/// Assumes an invariant counter, which every x86 CPU of the
+/// last decade and every ARM64 CPU has.
+///
+/// \code
+/// CycleClock::Calibrate();
+/// ULong ticks = CycleClock::Now();
+/// ...
+/// ULong nanoseconds = CycleClock::ToNanoseconds(ticks);
+/// \endcode
+///
+///////////////////////////////////////////////////////////
+
+} // time
+} // klib
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+#include <KLib/Config.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/File.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+class API_EXPORT GroupCommitWriter
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// \param file File open for output, usually with FileModes::Append;
+	///             must outlive the writer and only be written through it
+	///
+	///////////////////////////////////////////////////////////
+	GroupCommitWriter(BinaryFile& file);
+
+	GroupCommitWriter(const GroupCommitWriter&) = delete;
+	GroupCommitWriter& operator=(const GroupCommitWriter&) = delete;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write a record without waiting for the disk
+	///
+	/// The record is written in one piece, records from
+	/// other threads never end up inside it.
+	///
+	/// \param data Bytes of the record
+	/// \param size Number of bytes
+	///
+	/// \return Ticket to pass to WaitDurable(), 0 if the write failed
+	///
+	///////////////////////////////////////////////////////////
+	ULong Write(const void* data, size_t size);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write a record made of several pieces
+	///
+	/// \param segments Pieces of the record, in order
+	/// \param count Number of segments
+	///
+	/// \return Ticket to pass to WaitDurable(), 0 if the write failed
+	///
+	/// \see BinaryFile::WriteV
+	///
+	///////////////////////////////////////////////////////////
+	ULong Write(const IOSegment* segments, UInt count);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Wait until a record is on the disk
+	///
+	/// If no sync is running, the calling thread syncs the
+	/// file for every record written so far. Otherwise it
+	/// waits for the running sync, and the next one covers
+	/// its record along with everything else written
+	/// meanwhile.
+	///
+	/// \param ticket Returned by Write()
+	///
+	/// \return True once the record is durable, false if a sync failed
+	///
+	///////////////////////////////////////////////////////////
+	bool WaitDurable(ULong ticket);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write a record and wait until it is on the disk
+	///
+	/// \return True once the record is durable
+	///
+	///////////////////////////////////////////////////////////
+	inline bool Append(const void* data, size_t size)
+	{
+		return WaitDurable(Write(data, size));
+	}
+
+	inline bool Append(std::initializer_list<IOSegment> segments)
+	{
+		return WaitDurable(Write(segments.begin(), static_cast<UInt>( segments.size() )));
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the number of syncs done so far
+	///
+	/// Compared with the number of records, shows how well
+	/// the syncs are shared.
+	///
+	///////////////////////////////////////////////////////////
+	ULong GetSyncCount();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check that no write or sync has failed
+	///
+	/// A failed sync can't be retried: the OS may have
+	/// dropped the data it couldn't write, so every later
+	/// WaitDurable() fails too.
+	///
+	///////////////////////////////////////////////////////////
+	bool IsHealthy();
+
+private:
+	BinaryFile& mFile;
+	std::mutex mMutex; // Guards the file and the counters
+	std::condition_variable mCondition; // Signals a finished sync
+	ULong mWritten; // Ticket of the last record written
+	ULong mDurable; // Records up to this ticket are on the disk
+	ULong mSyncs;
+	bool mSyncing; // A thread is syncing, without holding the mutex
+	bool mFailed;
+};
+///////////////////////////////////////////////////////////
+/// \class GroupCommitWriter
+/// \brief Durable appends, sharing one sync between many records
+/// \ingroup FileIO
+///
+/// Syncing after every record costs a disk flush each,
+/// a few milliseconds, which caps a journal at a few
+/// hundred records a second. Here threads append
+/// concurrently and whoever waits first syncs for everyone;
+/// records written during that sync share the next one.
+/// The more writers, the more records each sync covers.
+///
+/// \code
+/// BinaryFile file("journal.bin", FileModes::Append);
+/// GroupCommitWriter journal(file);
+/// // On any number of threads
+/// if (!journal.Append({ header, payload }))
+///     KL_ERROR("Journal write failed");
+/// \endcode
+///
+/// \see FileBase::Sync, AtomicFile
+///
+///////////////////////////////////////////////////////////
+
+class API_EXPORT AtomicFile : public BinaryFile
+{
+public:
+	AtomicFile() {};
+
+	///////////////////////////////////////////////////////////
+	/// \brief 'Attempt-Open' Constructor
+	///
+	/// \param path File to replace
+	///
+	///////////////////////////////////////////////////////////
+	AtomicFile(String path)
+	{
+		Open(path);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Destructor
+	///
+	/// Discards the new contents unless Commit() was called.
+	///
+	///////////////////////////////////////////////////////////
+	~AtomicFile();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Start writing the new contents of a file
+	///
+	/// Writes go to path + ".tmp"; the file at path is left
+	/// alone until Commit().
+	///
+	/// \param path File to replace, doesn't have to exist
+	/// \param mode Read may be added, the file is always written from empty
+	///
+	/// \return Successful
+	///
+	///////////////////////////////////////////////////////////
+	bool Open(String path, FileMode mode = FileModes::Overwrite) override;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Replace the file with what was written
+	///
+	/// Syncs and closes the temporary file, renames it over
+	/// the target, then syncs the directory so the rename
+	/// itself survives a crash.
+	///
+	/// \return True if the file was replaced; on failure the old file is untouched
+	///
+	///////////////////////////////////////////////////////////
+	bool Commit();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Throw away what was written
+	///
+	/// Closes and deletes the temporary file.
+	///
+	///////////////////////////////////////////////////////////
+	void Discard();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the path of the file being replaced
+	///
+	///////////////////////////////////////////////////////////
+	inline const String& GetTargetPath() const
+	{
+		return mTargetPath;
+	}
+
+private:
+	String mTargetPath;
+};
+///////////////////////////////////////////////////////////
+/// \class AtomicFile
+/// \brief Replaces a whole file, all at once or not at all
+/// \ingroup FileIO
+///
+/// Rewriting a file in place leaves it half written if the
+/// program or machine dies partway. AtomicFile writes a
+/// temporary file next to it and renames that over the
+/// original, so readers and crash recovery see either the
+/// old file or the complete new one.
+///
+/// \code
+/// AtomicFile file("save.bin");
+/// BinaryStream stream(file);
+/// stream << world;
+/// if (!file.Commit())
+///     KL_ERROR("Couldn't save");
+/// \endcode
+///
+/// \see GroupCommitWriter
+///
+///////////////////////////////////////////////////////////
+
+} // io
+} // klib
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <type_traits>
 
 #include <KLib/Config.hpp>
 #include <KLib/ArrayList.hpp>
@@ -41,22 +42,89 @@ enum FileModes : FileMode
 	//Note: These can be mixed, i.e. (FileMode::Read | FileMode::Write), apart from Overwrite to Append, the rest are compatible
 };
 
+namespace AccessHints
+{
+enum AccessHint
+{
+	Normal = 0, // No particular pattern, the kernel's default read-ahead
+	Sequential = 1, // Read front to back, read ahead aggressively and drop pages behind
+	Random = 2, // No read-ahead, only fault in what is touched
+	WillNeed = 3, // Start reading the range in now
+	DontNeed = 4 // The range won't be used again soon, its pages can be reclaimed (CopyOnWrite changes in it are lost)
+};
+}
+typedef AccessHints::AccessHint AccessHint;
+
+#ifdef _WIN32
+typedef void* NativeFileHandle; // HANDLE
+#else
+typedef int NativeFileHandle; // File descriptor
+#endif
+
 namespace priv
 {
-std::ios::openmode TranslateFileMode(FileMode mode)
+inline std::ios::openmode TranslateFileMode(FileMode mode)
 {
-	std::ios::openmode openmode;
+	std::ios::openmode openmode = std::ios::openmode();
 
-	if (mode && FileModes::Read > 0) { openmode |= std::ios::in; }
-	if (mode && FileModes::Overwrite > 0) { openmode |= ( std::ios::out | std::ios::trunc ); }
-	if (mode && FileModes::Write > 0) { openmode |= std::ios::out; }
-	if (mode && FileModes::Append > 0) { openmode |= ( std::ios::out | std::ios::app ); }
-	if (mode && FileModes::Binary > 0) { openmode |= std::ios::binary; }
+	if (( mode & FileModes::Read ) > 0) { openmode |= std::ios::in; }
+	if (( mode & FileModes::Overwrite ) > 0) { openmode |= ( std::ios::out | std::ios::trunc ); }
+	if (( mode & FileModes::Write ) > 0) { openmode |= std::ios::out; }
+	if (( mode & FileModes::Append ) > 0) { openmode |= ( std::ios::out | std::ios::app ); }
+	if (( mode & FileModes::Binary ) > 0) { openmode |= std::ios::binary; }
 
 	return openmode;
 }
+
+// Any of the modes which allow output operations
+const FileMode WritableModes = FileModes::Write | FileModes::Overwrite | FileModes::Append;
+
+// fdatasync or FlushFileBuffers; opens the path itself if the descriptor is invalid
+API_EXPORT bool SyncPath(const String& path, NativeFileHandle descriptor);
 }
 
+struct API_EXPORT IOSegment
+{
+	IOSegment()
+		: data(nullptr), size(0) {}
+
+	IOSegment(void* data, size_t size)
+		: data(static_cast<char*>( data )), size(size) {}
+
+	// Fine for writes, reading into it would write to const memory
+	IOSegment(const void* data, size_t size)
+		: data(static_cast<char*>( const_cast<void*>( data ) )), size(size) {}
+
+	// The characters, without the length prefix BinaryStream writes; resize first to read into it
+	IOSegment(const String& str)
+		: data(const_cast<char*>( str.data() )), size(str.size()) {}
+
+	IOSegment(const ByteBuffer& buffer)
+		: data(buffer), size(static_cast<size_t>( buffer.GetSize() )) {}
+
+	// The bytes of a plain value, struct or array
+	template<typename T, typename = typename std::enable_if<std::is_pod<T>::value>::type>
+	IOSegment(T& value)
+		: data(reinterpret_cast<char*>( const_cast<typename std::remove_const<T>::type*>( &value ) )), size(sizeof(T)) {}
+
+	char* data;
+	size_t size;
+};
+///////////////////////////////////////////////////////////
+/// \class IOSegment
+/// \brief One piece of a scatter/gather read or write
+/// \ingroup FileIO
+///
+/// \see BinaryFile::WriteV, BinaryFile::ReadV
+///
+///////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+const NativeFileHandle InvalidNativeHandle = reinterpret_cast<void*>( -1 ); // INVALID_HANDLE_VALUE
+#else
+const NativeFileHandle InvalidNativeHandle = -1;
+#endif
+
 ///////////////////////////////////////////////////////////
 /// \namespace te::io
 /// \defgroup FileIO
@@ -69,6 +137,8 @@ std::ios::openmode TranslateFileMode(FileMode mode)
 class API_EXPORT FileBase
 {
 public:
+	FileBase() : mOpen(false), mMode(0), mSize(0) {};
+
 	virtual ~FileBase()
 	{
 		if (IsOpen())
@@ -103,9 +173,12 @@ public:
 		mStream.open(path, mode_translated);
 		mOpen = mStream.is_open();
 		mMode = mode;
+		mPath = path;
 
 		if (!mOpen)
 			KL_WARNING("Failed to open file '" + path + "'");
+		else
+			UpdateSize();
 
 		return mOpen;
 	}
@@ -130,10 +203,11 @@ public:
 	///////////////////////////////////////////////////////////
 	inline void Close()
 	{
-		if (( mMode & std::ios::out ) > 0)
+		if (( mMode & priv::WritableModes ) > 0)
 			Flush();
 
 		mStream.close();
+		mOpen = false;
 	}
 
 	///////////////////////////////////////////////////////////
@@ -142,27 +216,42 @@ public:
 	///////////////////////////////////////////////////////////
 	inline void Flush()
 	{
-		KL_ASSERT((mMode & io::FileModes::Write) > 0);
+		KL_ASSERT((mMode & priv::WritableModes) > 0);
 		mStream.flush();
 	}
 
+	///////////////////////////////////////////////////////////
+	/// \brief Flush, and wait until the data is on the disk
+	///
+	/// Flush() only hands the data to the OS, which may keep
+	/// it in memory for a while; a crash or power cut then
+	/// loses it. Sync() also waits for the disk (fdatasync,
+	/// F_FULLFSYNC on macOS, FlushFileBuffers on Windows).
+	/// This takes milliseconds, see GroupCommitWriter for
+	/// syncing many records at once.
+	///
+	/// \return True once the data is durable
+	///
+	///////////////////////////////////////////////////////////
+	bool Sync();
+
 	///////////////////////////////////////////////////////////
 	/// \brief Get the size of the file
 	///
-	/// This function may be expensive if called over and over again,
-	/// so if you need this value multiple times, store it.
+	/// Read from the open file's metadata (fstat) when it is
+	/// opened and cached, so this doesn't move the pointer
+	/// and is free for files opened read-only. For files
+	/// opened for output, writes past the cached size grow
+	/// it to the write position; nothing is flushed.
 	///
 	/// \return file size in bytes
 	///
 	///////////////////////////////////////////////////////////
-	inline UInt GetSize()
+	inline ULong GetSize()
 	{
-		KL_ASSERT((mMode & io::FileModes::Read) > 0);
-		UInt pos = Tell(); // store current pos to restore
-		Seek(0, std::ios::end); // go to end of file
-		UInt length = Tell(); // retrieve pos at end
-		Seek(pos); // restore last position
-		return length;
+		if (( mMode & priv::WritableModes ) > 0)
+			UpdateWrittenSize();
+		return mSize;
 	}
 
 	///////////////////////////////////////////////////////////
@@ -198,9 +287,11 @@ public:
 	/// \return file healthy
 	///
 	///////////////////////////////////////////////////////////
-	inline bool Seek(UInt pos, std::ios::seekdir way = std::ios::beg)
+	inline bool Seek(ULong pos, std::ios::seekdir way = std::ios::beg)
 	{
-		mStream.seekg(pos, way);
+		if (( mMode & priv::WritableModes ) > 0)
+			UpdateWrittenSize(); // The data written so far may end here
+		mStream.seekg(static_cast<std::streamoff>( pos ), way);
 		return IsHealthy();
 	}
 
@@ -212,9 +303,11 @@ public:
 	/// \return file healthy
 	///
 	///////////////////////////////////////////////////////////
-	inline bool Skip(Int amount)
+	inline bool Skip(Long amount)
 	{
-		mStream.seekg(amount, std::ios_base::cur);
+		if (( mMode & priv::WritableModes ) > 0)
+			UpdateWrittenSize();
+		mStream.seekg(static_cast<std::streamoff>( amount ), std::ios_base::cur);
 		return IsHealthy();
 	}
 
@@ -224,9 +317,9 @@ public:
 	/// \return Position of pointer
 	///
 	///////////////////////////////////////////////////////////
-	inline UInt Tell()
+	inline ULong Tell()
 	{
-		return mStream.tellg();
+		return static_cast<ULong>( static_cast<std::streamoff>( mStream.tellg() ) );
 	}
 
 	///////////////////////////////////////////////////////////
@@ -242,7 +335,63 @@ public:
 	{
 		KL_ASSERT((mMode & io::FileModes::Read) > 0);
 		return ( mStream.rdstate() == std::ios::eofbit ) ||
-			( Tell() == (Int)(mStream.end) );
+			( Tell() >= GetSize() );
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Tell the kernel how a range will be read
+	///
+	/// WillNeed is the same as Prefetch(). DontNeed drops the
+	/// range from the page cache wherever posix_fadvise
+	/// exists. Sequential, Random and Normal change the
+	/// read-ahead of the open file itself and need its
+	/// descriptor, see GetNativeHandle().
+	///
+	/// \param hint Expected access pattern
+	/// \param offset First byte of the range
+	/// \param length Bytes in the range, 0 for the rest of the file
+	///
+	/// \return True if the hint was applied
+	///
+	///////////////////////////////////////////////////////////
+	bool Advise(AccessHint hint, ULong offset = 0, ULong length = 0);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Start reading a range into the page cache
+	///
+	/// Returns straight away, a short-lived thread queues the
+	/// reads (posix_fadvise on POSIX, plain reads on Windows).
+	/// Reads of the range later on find the data in memory
+	/// instead of waiting for the disk, so loading can
+	/// overlap with other work.
+	///
+	/// \param offset First byte of the range
+	/// \param length Bytes in the range, 0 for the rest of the file
+	///
+	/// \return True if the prefetch was started
+	///
+	///////////////////////////////////////////////////////////
+	bool Prefetch(ULong offset, ULong length = 0);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the OS handle of the open file
+	///
+	/// fstream doesn't expose it; this is only available with
+	/// libstdc++ on POSIX, which keeps the descriptor where a
+	/// subclass can reach it.
+	///
+	/// \return File descriptor, InvalidNativeHandle if not available or not open
+	///
+	///////////////////////////////////////////////////////////
+	NativeFileHandle GetNativeHandle();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the path the file was opened with
+	///
+	///////////////////////////////////////////////////////////
+	inline const String& GetPath() const
+	{
+		return mPath;
 	}
 
 	///////////////////////////////////////////////////////////
@@ -272,11 +421,21 @@ public:
 	}
 
 protected:
+	void UpdateSize();
+
+	// Writing past the end grows the file up to the write position
+	inline void UpdateWrittenSize()
+	{
+		std::streamoff position = mStream.tellp();
+		if (position > static_cast<std::streamoff>( mSize ))
+			mSize = static_cast<ULong>( position );
+	}
+
 	bool mOpen;
 	String mPath;
 	std::fstream mStream;
 	FileMode mMode;
-	UInt mSize;
+	ULong mSize; // Cached from the open file's metadata, see GetSize()
 };
 ///////////////////////////////////////////////////////////
 /// \class FileBase
@@ -414,7 +573,7 @@ public:
 	///////////////////////////////////////////////////////////
 	inline bool Write(const String& data)
 	{
-		KL_ASSERT((mMode & io::FileModes::Write) > 0);
+		KL_ASSERT((mMode & priv::WritableModes) > 0);
 		mStream << data;
 		return IsHealthy();
 	}
@@ -431,8 +590,8 @@ public:
 	///////////////////////////////////////////////////////////
 	inline bool WriteLine(const String& data)
 	{
-		KL_ASSERT((mMode & io::FileModes::Write) > 0);
-		mStream << data << '\r\n';
+		KL_ASSERT((mMode & priv::WritableModes) > 0);
+		mStream << data << '\n'; // Text mode writes "\r\n" on Windows
 		return IsHealthy();
 	}
 };
@@ -600,11 +759,55 @@ public:
 	///////////////////////////////////////////////////////////
 	inline bool Write(const char* data, UInt bytes)
 	{
-		KL_ASSERT((mMode & io::FileModes::Write) > 0);
+		KL_ASSERT((mMode & priv::WritableModes) > 0);
 		mStream.write(data, bytes);
 		return IsHealthy();
 	}
-	
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write several buffers as one
+	///
+	/// Gathers the segments in order with a single pwritev
+	/// where the descriptor is available (see
+	/// GetNativeHandle()), instead of a write per piece.
+	/// Elsewhere the segments are written one by one.
+	///
+	/// \code
+	/// file.WriteV({ header, IOSegment(&nameLength, sizeof(UInt)), name, payload });
+	/// \endcode
+	///
+	/// \param segments Buffers to write, in order
+	/// \param count Number of segments
+	///
+	/// \return success
+	///
+	///////////////////////////////////////////////////////////
+	bool WriteV(const IOSegment* segments, UInt count);
+
+	inline bool WriteV(std::initializer_list<IOSegment> segments)
+	{
+		return WriteV(segments.begin(), static_cast<UInt>( segments.size() ));
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read into several buffers at once
+	///
+	/// Scatters consecutive bytes of the file over the
+	/// segments in order, with a single preadv where the
+	/// descriptor is available.
+	///
+	/// \param segments Buffers to fill, in order
+	/// \param count Number of segments
+	///
+	/// \return success, false if the file ends before every segment is full
+	///
+	///////////////////////////////////////////////////////////
+	bool ReadV(const IOSegment* segments, UInt count);
+
+	inline bool ReadV(std::initializer_list<IOSegment> segments)
+	{
+		return ReadV(segments.begin(), static_cast<UInt>( segments.size() ));
+	}
 };
 ///////////////////////////////////////////////////////////
 /// \class BinaryFile
@@ -624,6 +827,33 @@ public:
 ///
 ///////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////
+/// \brief Copy bytes from one open file to another
+///
+/// Reads from the source's position and writes at the
+/// destination's, moving both past the data. Where both
+/// descriptors are available (see FileBase::GetNativeHandle())
+/// the kernel moves the data with copy_file_range or
+/// sendfile, without copying it into the program; otherwise
+/// it goes through a 1MB buffer.
+///
+/// \code
+/// BinaryFile package("assets.pak", FileModes::Append);
+/// BinaryFile texture("stone.dds");
+/// Transfer(texture, package); // Append the whole texture
+/// \endcode
+///
+/// \param source File open for input
+/// \param destination File open for output
+/// \param length Bytes to copy, clamped to the end of the source
+///
+/// \return Bytes copied
+///
+/// \see filesystem::File::Copy
+///
+///////////////////////////////////////////////////////////
+API_EXPORT ULong Transfer(FileBase& source, FileBase& destination, ULong length = ~0ULL);
+
 } // io
 } // klib
 
@@ -51,6 +51,37 @@ public:
 	///
 	///////////////////////////////////////////////////////////
 	static bool Delete(const String& path);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the size of a file
+	///
+	/// Reads the file's metadata, the file isn't opened.
+	/// 64-bit, so files over 4GB are reported correctly.
+	///
+	/// \param path Path to file
+	///
+	/// \return Size in bytes, -1 if the file doesn't exist
+	///
+	///////////////////////////////////////////////////////////
+	static Long GetSize(const String& path);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Copy a file, or part of one
+	///
+	/// The data is copied by the kernel where it can be
+	/// (copy_file_range, sendfile, CopyFile on Windows), so it
+	/// never passes through the program; a filesystem with
+	/// reflinks may not copy it at all. See io::Transfer().
+	///
+	/// \param source File to copy
+	/// \param destination New file, replaced if it exists
+	/// \param offset First byte of source to copy
+	/// \param length Bytes to copy, clamped to the end of source
+	///
+	/// \return True if the whole range was copied
+	///
+	///////////////////////////////////////////////////////////
+	static bool Copy(const String& source, const String& destination, ULong offset = 0, ULong length = ~0ULL);
 };
 
 class API_EXPORT Dir
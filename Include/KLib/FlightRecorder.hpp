@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+
+#include <KLib/Config.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/Logging.hpp>
+
+///////////////////////////////////////////////////////////
+/// Message characters kept per FlightRecorder record,
+/// longer messages are cut short
+///
+///////////////////////////////////////////////////////////
+#if !defined(KL_FLIGHT_RECORD_MESSAGE)
+#	define KL_FLIGHT_RECORD_MESSAGE 200
+#endif
+
+namespace klib
+{
+namespace logging
+{
+
+class API_EXPORT FlightRecorder : public LogListener
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// Allocates every record up front, logging never
+	/// allocates afterwards.
+	///
+	/// \param capacity Number of entries kept, rounded up to a power of two
+	///
+	///////////////////////////////////////////////////////////
+	FlightRecorder(UInt capacity = 4096);
+
+	virtual ~FlightRecorder(void);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Record an entry
+	///
+	/// Safe to call from many threads at once, overwrites
+	/// the oldest record once the ring is full.
+	///
+	///////////////////////////////////////////////////////////
+	virtual bool Log(const LogEntry& entry) override;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write the recorded entries to a file descriptor
+	///
+	/// Oldest first, one line per entry. Only uses write(),
+	/// so it can be called from a signal handler. Records
+	/// which are being overwritten while dumping are skipped.
+	///
+	/// \param fd Open file descriptor to write to
+	///
+	///////////////////////////////////////////////////////////
+	void DumpTo(int fd) const;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write the recorded entries to a file
+	///
+	/// \param path File to create or overwrite
+	///
+	/// \return True if the file could be written
+	///
+	///////////////////////////////////////////////////////////
+	bool Dump(const String& path) const;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the number of records in the ring
+	///
+	/// \return Capacity of the recorder
+	///
+	///////////////////////////////////////////////////////////
+	inline UInt GetCapacity() const
+	{
+		return static_cast<UInt>( mMask + 1 );
+	}
+
+private:
+	struct Record
+	{
+		std::atomic<ULong> sequence; // Odd while being written, 2 * (slot + 1) once complete
+		ULong timestamp;
+		const SourceLocation* source;
+		Byte clock;
+		Byte level;
+		UShort size;
+		char message[KL_FLIGHT_RECORD_MESSAGE];
+	};
+
+	Record* mpRecords;
+	ULong mMask;
+	std::atomic<ULong> mPosition;
+};
+///////////////////////////////////////////////////////////
+/// \class FlightRecorder
+/// \brief Keeps the last N log entries in memory
+///
+/// Never touches the disk while the program runs: entries
+/// are copied into a ring of fixed-size records. Combined
+/// with CrashHandler the ring is dumped to a file when the
+/// program crashes, which gives full context for a crash
+/// without paying for verbose file logging.
+///
+/// \code
+/// StrongPtr<FlightRecorder> recorder(new FlightRecorder(8192));
+/// klib::DefaultLogger.SetLevel(DEBUG_LOG);
+/// klib::DefaultLogger.AddListener(recorder);
+/// fileWriter->SetLevel(WARNING_LOG); // file only gets warnings and up
+/// CrashHandler::Install(recorder, "crash.log");
+/// \endcode
+///
+/// \see CrashHandler
+///
+///////////////////////////////////////////////////////////
+
+} // logging
+} // klib
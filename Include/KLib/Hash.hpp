@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+
+#include <KLib/Config.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/ByteBuffer.hpp>
+#include <KLib/MappedFile.hpp>
+#include <KLib/BinaryStream.hpp>
+
+namespace klib
+{
+
+class API_EXPORT Crc32C
+{
+public:
+	Crc32C()
+		: mState(0xFFFFFFFF) {}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Add bytes to the checksum
+	///
+	/// Any split of the data gives the same result as
+	/// adding it all at once.
+	///
+	/// \param data Bytes to add
+	/// \param size Number of bytes
+	///
+	///////////////////////////////////////////////////////////
+	void Update(const void* data, size_t size);
+
+	inline void Update(const io::ByteBuffer& buffer)
+	{
+		Update(buffer, static_cast<size_t>( buffer.GetSize() ));
+	}
+
+	inline void Update(const io::MappedFile& file)
+	{
+		Update(file.GetData(), static_cast<size_t>( file.GetSize() ));
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the checksum of everything added so far
+	///
+	/// More data may still be added afterwards.
+	///
+	///////////////////////////////////////////////////////////
+	inline UInt Get() const
+	{
+		return ~mState;
+	}
+
+	inline void Reset()
+	{
+		mState = 0xFFFFFFFF;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Checksum a buffer in one call
+	///
+	///////////////////////////////////////////////////////////
+	static inline UInt Compute(const void* data, size_t size)
+	{
+		Crc32C crc;
+		crc.Update(data, size);
+		return crc.Get();
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check if the CPU's CRC32 instruction is used
+	///
+	/// SSE4.2 on x86, the CRC extension on ARMv8. Without it
+	/// a table-driven version is used, several times slower.
+	///
+	///////////////////////////////////////////////////////////
+	static bool IsHardwareAccelerated();
+
+private:
+	UInt mState;
+};
+///////////////////////////////////////////////////////////
+/// \class Crc32C
+/// \brief Streaming CRC-32C (Castagnoli) checksum
+///
+/// The CRC used by iSCSI, ext4 and SSE4.2, which computes
+/// it in hardware at several GB/s. Detects every burst of
+/// errors up to 32 bits, so it suits corruption checks on
+/// saved data; it is not a hash for tables.
+///
+/// \code
+/// Crc32C crc;
+/// crc.Update(header, sizeof(header));
+/// crc.Update(payload);
+/// if (crc.Get() != storedCrc)
+///     KL_ERROR("Save file is corrupt");
+/// \endcode
+///
+/// \see XXHash64, io::HashFile
+///
+///////////////////////////////////////////////////////////
+
+class API_EXPORT XXHash64
+{
+public:
+	XXHash64(ULong seed = 0)
+	{
+		Reset(seed);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Add bytes to the hash
+	///
+	/// \param data Bytes to add
+	/// \param size Number of bytes
+	///
+	///////////////////////////////////////////////////////////
+	void Update(const void* data, size_t size);
+
+	inline void Update(const io::ByteBuffer& buffer)
+	{
+		Update(buffer, static_cast<size_t>( buffer.GetSize() ));
+	}
+
+	inline void Update(const io::MappedFile& file)
+	{
+		Update(file.GetData(), static_cast<size_t>( file.GetSize() ));
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the hash of everything added so far
+	///
+	///////////////////////////////////////////////////////////
+	ULong Get() const;
+
+	void Reset(ULong seed = 0);
+
+	static inline ULong Compute(const void* data, size_t size, ULong seed = 0)
+	{
+		XXHash64 hash(seed);
+		hash.Update(data, size);
+		return hash.Get();
+	}
+
+private:
+	ULong mSeed;
+	ULong mLanes[4];
+	ULong mTotal; // Bytes added
+	char mBuffer[32]; // Bytes that don't make up a whole stripe yet
+	UInt mBuffered;
+};
+///////////////////////////////////////////////////////////
+/// \class XXHash64
+/// \brief Streaming 64-bit xxHash
+///
+/// XXH64, bit for bit the same as the reference
+/// implementation. Four independent lanes keep the CPU's
+/// multipliers busy, so it runs at memory speed on any
+/// 64-bit CPU. Not cryptographic: fine for checking data
+/// and for hash tables, not against deliberate tampering.
+///
+/// \see Crc32C, MurmurHash128
+///
+///////////////////////////////////////////////////////////
+
+struct API_EXPORT Hash128
+{
+	ULong low;
+	ULong high;
+
+	inline bool operator==(const Hash128& other) const
+	{
+		return low == other.low && high == other.high;
+	}
+
+	inline bool operator!=(const Hash128& other) const
+	{
+		return !( *this == other );
+	}
+};
+
+class API_EXPORT MurmurHash128
+{
+public:
+	MurmurHash128(UInt seed = 0)
+	{
+		Reset(seed);
+	}
+
+	void Update(const void* data, size_t size);
+
+	inline void Update(const io::ByteBuffer& buffer)
+	{
+		Update(buffer, static_cast<size_t>( buffer.GetSize() ));
+	}
+
+	inline void Update(const io::MappedFile& file)
+	{
+		Update(file.GetData(), static_cast<size_t>( file.GetSize() ));
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the hash of everything added so far
+	///
+	/// \return low and high are the reference's first and second 64-bit words
+	///
+	///////////////////////////////////////////////////////////
+	Hash128 Get() const;
+
+	void Reset(UInt seed = 0);
+
+	static inline Hash128 Compute(const void* data, size_t size, UInt seed = 0)
+	{
+		MurmurHash128 hash(seed);
+		hash.Update(data, size);
+		return hash.Get();
+	}
+
+private:
+	ULong mH1;
+	ULong mH2;
+	ULong mTotal;
+	char mBuffer[16];
+	UInt mBuffered;
+};
+///////////////////////////////////////////////////////////
+/// \class MurmurHash128
+/// \brief Streaming 128-bit MurmurHash3 (x64 variant)
+///
+/// Same results as MurmurHash3_x64_128. Use it where 64
+/// bits could collide, e.g. content-addressing millions of
+/// assets; it is about as fast as XXHash64.
+///
+/// \see XXHash64
+///
+///////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////
+/// \brief Hash bytes read from a stream
+///
+/// Memory streams are hashed in place, file streams are
+/// read a block at a time. The stream ends up past the
+/// bytes, as if they had been read.
+///
+/// \code
+/// XXHash64 hash;
+/// HashRead(hash, stream, payloadSize);
+/// \endcode
+///
+/// \param hasher Crc32C, XXHash64 or MurmurHash128
+/// \param stream Stream to read from
+/// \param bytes Number of bytes to read and hash
+///
+/// \return False if the stream ended first
+///
+///////////////////////////////////////////////////////////
+template<typename Hasher>
+bool HashRead(Hasher& hasher, io::BinaryStream& stream, ULong bytes)
+{
+	const UInt block = 256 * 1024;
+
+	if (stream.IsMemory())
+	{
+		while (bytes > 0)
+		{
+			UInt size = static_cast<UInt>( std::min<ULong>(bytes, block) );
+			const char* data = stream.ReadView(size);
+			if (!data)
+				return false;
+
+			hasher.Update(data, size);
+			bytes -= size;
+		}
+		return true;
+	}
+
+	ArrayList<char> buffer(static_cast<size_t>( std::min<ULong>(bytes, block) ));
+	while (bytes > 0)
+	{
+		UInt size = static_cast<UInt>( std::min<ULong>(bytes, block) );
+		if (!stream.Read(buffer.data(), size))
+			return false;
+
+		hasher.Update(buffer.data(), size);
+		bytes -= size;
+	}
+	return true;
+}
+
+namespace io
+{
+
+///////////////////////////////////////////////////////////
+/// \brief Read a whole file, handing it over in blocks
+///
+/// A reader thread reads ahead into a few large buffers
+/// while the calling thread consumes the ones already
+/// read, so consume() and the disk work at the same time.
+///
+/// \param path File to read
+/// \param consume Called on the calling thread with each block, in order
+///
+/// \return False if the file couldn't be opened or read
+///
+///////////////////////////////////////////////////////////
+API_EXPORT bool ReadOverlapped(const String& path, const std::function<void(const char*, size_t)>& consume);
+
+///////////////////////////////////////////////////////////
+/// \brief Hash a whole file
+///
+/// Reading and hashing overlap (see ReadOverlapped()), so
+/// this takes as long as the slower of the two rather than
+/// both added up.
+///
+/// \code
+/// XXHash64 hash;
+/// if (!io::HashFile("level1.pak", hash) || hash.Get() != expected)
+///     KL_ERROR("level1.pak is damaged");
+/// \endcode
+///
+/// \param path File to hash
+/// \param hasher Crc32C, XXHash64 or MurmurHash128, updated with the file's contents
+///
+/// \return False if the file couldn't be read
+///
+///////////////////////////////////////////////////////////
+template<typename Hasher>
+bool HashFile(const String& path, Hasher& hasher)
+{
+	return ReadOverlapped(path, [&hasher](const char* data, size_t size) { hasher.Update(data, size); });
+}
+
+} // io
+} // klib
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <iterator>
+
+#include <KLib/Config.hpp>
+#include <KLib/ArrayList.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/StringView.hpp>
+#include <KLib/File.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+class API_EXPORT LineReader
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// Reads from the file's current position onwards.
+	///
+	/// \param file Open file, must outlive the reader
+	/// \param chunkSize Bytes read at once, grows to fit a line longer than it
+	/// \param length Stop after this many bytes of the file, e.g. for a range of it
+	///
+	///////////////////////////////////////////////////////////
+	LineReader(TextFile& file, UInt chunkSize = 1024 * 1024, ULong length = ~0ULL);
+
+	LineReader(const LineReader&) = delete;
+	LineReader& operator=(const LineReader&) = delete;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read the next line
+	///
+	/// The view points into the reader's buffer and stays
+	/// valid until the next call; use line.ToString() to
+	/// keep it. Accepts "\n" and "\r\n" line endings, and a
+	/// last line with no ending.
+	///
+	/// \param line Set to the line, without its line ending
+	///
+	/// \return False at the end of the file
+	///
+	///////////////////////////////////////////////////////////
+	bool Next(StringView& line);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read the next line into a String
+	///
+	/// \param line Set to a copy of the line
+	///
+	/// \return False at the end of the file
+	///
+	///////////////////////////////////////////////////////////
+	bool Next(String& line);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the number of lines read so far
+	///
+	///////////////////////////////////////////////////////////
+	inline ULong GetLineNumber() const
+	{
+		return mLineNumber;
+	}
+
+	class Iterator
+	{
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef StringView value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const StringView* pointer;
+		typedef const StringView& reference;
+
+		Iterator()
+			: mpReader(nullptr) {}
+
+		explicit Iterator(LineReader* reader)
+			: mpReader(reader)
+		{
+			++( *this );
+		}
+
+		inline const StringView& operator*() const
+		{
+			return mLine;
+		}
+
+		inline const StringView* operator->() const
+		{
+			return &mLine;
+		}
+
+		inline Iterator& operator++()
+		{
+			if (!mpReader->Next(mLine))
+				mpReader = nullptr;
+			return *this;
+		}
+
+		inline bool operator==(const Iterator& other) const
+		{
+			return mpReader == other.mpReader;
+		}
+
+		inline bool operator!=(const Iterator& other) const
+		{
+			return mpReader != other.mpReader;
+		}
+
+	private:
+		LineReader* mpReader; // Null at the end
+		StringView mLine;
+	};
+
+	inline Iterator begin()
+	{
+		return Iterator(this);
+	}
+
+	inline Iterator end()
+	{
+		return Iterator();
+	}
+
+private:
+	bool Fill();
+
+	TextFile& mFile;
+	ArrayList<char> mBuffer;
+	size_t mStart; // First unread byte in mBuffer
+	size_t mEnd; // One past the last byte read into mBuffer
+	bool mEndOfFile;
+	ULong mRemaining; // Bytes left to read before the length limit
+	ULong mLineNumber;
+};
+///////////////////////////////////////////////////////////
+/// \class LineReader
+/// \brief Reads the lines of a text file without copying them
+/// \ingroup FileIO
+///
+/// The file is read a large chunk at a time and line
+/// endings are found with memchr, which the C library
+/// vectorizes, so lines are scanned at memory speed. Every
+/// line is a view into the chunk: nothing is allocated
+/// per line, where TextFile::ReadLine() makes a new String
+/// for each one.
+///
+/// \code
+/// TextFile file("numbers.txt");
+/// LineReader reader(file);
+/// Long sum = 0;
+/// for (const StringView& line : reader)
+///     sum += FromString<Long>(line);
+/// \endcode
+///
+/// \see TextFile, StringView
+///
+///////////////////////////////////////////////////////////
+
+} // io
+} // klib
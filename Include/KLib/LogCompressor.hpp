@@ -0,0 +1,202 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+#include <KLib/Config.hpp>
+#include <KLib/LinkedList.hpp>
+#include <KLib/Map.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/Compression.hpp>
+#include <KLib/Logging.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+namespace priv
+{
+class CompressorWorker;
+}
+
+class API_EXPORT LogCompressor
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// Starts the background thread, which idles until a file
+	/// is queued.
+	///
+	/// \param removeOriginal Delete each file once its compressed copy is complete
+	/// \param blockSize Bytes compressed at once
+	///
+	///////////////////////////////////////////////////////////
+	LogCompressor(bool removeOriginal = true, UInt blockSize = 256 * 1024);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Default Destructor
+	///
+	/// Compresses every queued file before returning.
+	///
+	///////////////////////////////////////////////////////////
+	~LogCompressor(void);
+
+	LogCompressor(const LogCompressor&) = delete;
+	LogCompressor& operator=(const LogCompressor&) = delete;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Queue a closed log file for compression
+	///
+	/// Written to path + Extension on the background thread.
+	/// The file must not be written to any more.
+	///
+	/// \param path File to compress
+	///
+	///////////////////////////////////////////////////////////
+	void Compress(const String& path);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Block until every queued file is done
+	///
+	///////////////////////////////////////////////////////////
+	void Wait();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Compress a file on the calling thread
+	///
+	/// Streams the file through a CompressedWriter, so memory
+	/// use doesn't depend on the size of the file. The
+	/// destination is written to a temporary name first and
+	/// renamed, so it is never seen half done.
+	///
+	/// \param source File to read
+	/// \param destination File to create
+	/// \param blockSize Bytes compressed at once
+	///
+	/// \return True if the compressed file is complete
+	///
+	///////////////////////////////////////////////////////////
+	static bool CompressFile(const String& source, const String& destination, UInt blockSize = 256 * 1024);
+
+	static const char* const Extension; // ".klz"
+
+private:
+	friend class priv::CompressorWorker;
+
+	bool mRemoveOriginal;
+	UInt mBlockSize;
+
+	std::mutex mMutex;
+	std::condition_variable mCondition; // Signals new work, and the queue running empty
+	LinkedList<String> mQueue;
+	bool mBusy; // A file is being compressed
+	bool mStopping;
+
+	priv::CompressorWorker* mpWorker;
+};
+///////////////////////////////////////////////////////////
+/// \class LogCompressor
+/// \brief Compresses closed log files on a background thread
+///
+/// On Linux, macOS and Windows the thread runs at the
+/// lowest CPU and IO priority, so compressing yesterday's
+/// logs doesn't compete with the program for disk or CPU.
+/// Files are compressed with CompressBlock in the frame
+/// format of CompressedWriter; CompressedLogReader reads
+/// them back entry by entry.
+///
+/// \code
+/// StrongPtr<LogCompressor> compressor(new LogCompressor());
+/// StrongPtr<RotatingLogWriter> writer(new RotatingLogWriter("server.log"));
+/// writer->SetCompressor(compressor); // every full segment gets compressed
+/// \endcode
+///
+/// \see CompressedLogReader, RotatingLogWriter
+///
+///////////////////////////////////////////////////////////
+
+class API_EXPORT CompressedLogReader
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Open a compressed log
+	///
+	/// \param path File written by LogCompressor
+	///
+	/// \return True if the file is a compressed log
+	///
+	///////////////////////////////////////////////////////////
+	bool Open(const String& path);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read the next line of a text or JSON log
+	///
+	/// \param line Set to the line, without the newline
+	///
+	/// \return False at the end of the log
+	///
+	///////////////////////////////////////////////////////////
+	bool NextLine(String& line);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read the next record of a LOG_FORMAT_BINARY log
+	///
+	/// Restores the timestamp, level, message and fields.
+	/// The call site isn't stored. The entry's source only
+	/// holds the category if one with the stored name exists
+	/// in this program, GetCategory() always has the name.
+	///
+	/// \param entry Set to the entry
+	///
+	/// \return False at the end of the log, or if a record is corrupt
+	///
+	///////////////////////////////////////////////////////////
+	bool Next(LogEntry& entry);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the category of the entry last read by Next()
+	///
+	/// \return Category name, empty if it had none
+	///
+	///////////////////////////////////////////////////////////
+	inline const String& GetCategory() const
+	{
+		return mCategory;
+	}
+
+	inline bool IsCorrupt() const
+	{
+		return mReader.IsCorrupt();
+	}
+
+private:
+	const SourceLocation* FindSource();
+
+	io::CompressedReader mReader;
+	String mRecord;
+	String mCategory;
+	Map<String, SourceLocation> mSources; // Map nodes don't move, entries point at them
+};
+///////////////////////////////////////////////////////////
+/// \class CompressedLogReader
+/// \brief Iterates the entries of a compressed log
+///
+/// Decompresses one block at a time, so logs far bigger
+/// than memory can be searched.
+///
+/// \code
+/// CompressedLogReader reader;
+/// reader.Open("server.log.3.klz");
+/// String line;
+/// while (reader.NextLine(line))
+///     if (line.find("[ERROR]") != String::npos)
+///         std::cout << line << '\n';
+/// \endcode
+///
+///////////////////////////////////////////////////////////
+
+} // logging
+} // klib
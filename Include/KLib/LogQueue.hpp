@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include <KLib/Config.hpp>
+#include <KLib/ArrayList.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/NonCopyable.hpp>
+#include <KLib/Logging.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+class API_EXPORT LogQueue : NonCopyable
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// Allocates all of the slots up front, the queue never
+	/// allocates afterwards.
+	///
+	/// \param capacity Number of entries the queue can hold, rounded up to a power of two
+	/// \param policy What Push() does when the queue is full
+	///
+	///////////////////////////////////////////////////////////
+	LogQueue(UInt capacity, OverflowPolicy policy = OVERFLOW_BLOCK);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Default Destructor
+	///
+	/// Frees the slots, any entries still queued are lost
+	///
+	///////////////////////////////////////////////////////////
+	~LogQueue();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Push an entry onto the queue
+	///
+	/// Safe to call from any number of threads at once.
+	/// The entry is moved from.
+	///
+	/// If the queue is full the overflow policy decides
+	/// what happens: OVERFLOW_BLOCK spins until the consumer
+	/// frees a slot, OVERFLOW_DROP_NEWEST discards this entry
+	/// and OVERFLOW_DROP_OLDEST discards the oldest queued one.
+	///
+	/// \param entry Entry to queue
+	///
+	/// \return False if the entry was dropped
+	///
+	///////////////////////////////////////////////////////////
+	bool Push(LogEntry& entry);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Pop up to maxCount entries
+	///
+	/// Appends the popped entries to 'batch' in the order they
+	/// were pushed. Only one thread should be popping.
+	///
+	/// \param batch Array to append entries to
+	/// \param maxCount Maximum number of entries to pop
+	///
+	/// \return Number of entries popped
+	///
+	///////////////////////////////////////////////////////////
+	UInt PopBatch(ArrayList<LogEntry>& batch, UInt maxCount);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check if there is nothing left to pop
+	///
+	/// \return True if the queue is empty
+	///
+	///////////////////////////////////////////////////////////
+	bool IsEmpty() const;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the number of slots
+	///
+	/// \return Capacity of the queue
+	///
+	///////////////////////////////////////////////////////////
+	inline UInt GetCapacity() const
+	{
+		return static_cast<UInt>( mMask + 1 );
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the overflow policy
+	///
+	/// \return Policy used when the queue is full
+	///
+	///////////////////////////////////////////////////////////
+	inline OverflowPolicy GetPolicy() const
+	{
+		return mPolicy;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the number of entries dropped due to overflow
+	///
+	/// \return Entries dropped since the queue was created
+	///
+	///////////////////////////////////////////////////////////
+	inline ULong GetDroppedCount() const
+	{
+		return mDropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	bool TryPush(LogEntry& entry);
+	bool TryPop(LogEntry& entry);
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		LogEntry entry;
+	};
+
+	Cell* mpCells;
+	size_t mMask;
+	OverflowPolicy mPolicy;
+
+	// Producers and the consumer hammer different counters, keep them on their own cache lines
+	char mPadding0[64];
+	std::atomic<size_t> mEnqueuePosition;
+	char mPadding1[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> mDequeuePosition;
+	char mPadding2[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<ULong> mDropped;
+};
+///////////////////////////////////////////////////////////
+/// \class LogQueue
+/// \brief Bounded multi-producer/single-consumer ring of log entries
+///
+/// Used by Logger in asynchronous mode: every thread that
+/// logs pushes onto the queue, and a single background
+/// thread pops entries off in batches and hands them to
+/// the listeners.
+///
+/// Each slot carries a sequence number, so producers only
+/// contend on one atomic counter and never take a lock.
+///
+/// \code
+/// LogQueue queue(1024, OVERFLOW_DROP_OLDEST);
+/// queue.Push(entry); // any thread
+///
+/// ArrayList<LogEntry> batch;
+/// queue.PopBatch(batch, 256); // consumer thread
+/// \endcode
+///
+/// \see Logger::StartAsync
+///
+///////////////////////////////////////////////////////////
+
+} // logging
+} // klib
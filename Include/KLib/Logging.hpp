@@ -1,19 +1,52 @@
 #pragma once
 
-//TODO thread safe (dont allow logging as well as adding new listeners etc.)
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <utility>
 
 #include <KLib/Config.hpp>
+#include <KLib/ArrayList.hpp>
 #include <KLib/Number.hpp>
 #include <KLib/String.hpp>
 #include <KLib/Memory.hpp>
-#include <KLib/File.hpp>
+#include <KLib/CycleClock.hpp>
+#include <KLib/RateLimiter.hpp>
+
+///////////////////////////////////////////////////////////
+/// Compile-time minimum log level (0 = DEBUG_LOG ... 4 = FATAL_LOG)
+///
+/// Log macros below this level expand to nothing, so their
+/// arguments are never compiled in. Define it before
+/// including this header, or with the build, e.g.
+/// -DKL_LOG_MIN_LEVEL=1 to strip all KL_DEBUGLOG calls.
+///
+///////////////////////////////////////////////////////////
+#if !defined(KL_LOG_MIN_LEVEL)
+#	define KL_LOG_MIN_LEVEL 0
+#endif
 
 namespace klib
 {
 
+namespace io
+{
+class TextFile; // Forward declaration, File.hpp logs through this header
+}
+
 namespace logging
 {
 
+class LogQueue;
+
+namespace priv
+{
+class AsyncLogWorker;
+struct LogCategoryRegistry;
+}
+
 enum LogLevel
 {
 	DEBUG_LOG 	= 0, 	// Arbitrary 'print' debugging, for testing only.
@@ -23,139 +56,1203 @@ enum LogLevel
 	FATAL_LOG 	= 4		// Fatal errors stop execution.
 };
 
+enum OverflowPolicy
+{
+	OVERFLOW_BLOCK			= 0,	// Wait for the background thread to free a slot, nothing is lost.
+	OVERFLOW_DROP_NEWEST	= 1,	// Discard the entry being logged.
+	OVERFLOW_DROP_OLDEST	= 2		// Discard the oldest queued entry to make room.
+};
+
+enum TimeSource
+{
+	TIME_SYSTEM_CLOCK		= 0,	// Nanoseconds since the unix epoch, read on every entry.
+	TIME_CYCLE_COUNTER		= 1		// Raw CycleClock ticks, converted only when formatted.
+};
+
+///////////////////////////////////////////////////////////
+/// Number of message characters a LogEntry stores inline
+///
+/// Shorter messages are logged without touching the heap,
+/// longer ones spill into a String.
+///
+///////////////////////////////////////////////////////////
+#if !defined(KL_LOG_INLINE_MESSAGE)
+#	define KL_LOG_INLINE_MESSAGE 192
+#endif
+
+class API_EXPORT LogCategory
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// Registers the category and picks up the level set for
+	/// it or its closest parent. Categories are meant to be
+	/// globals, see KL_DEFINE_LOG_CATEGORY.
+	///
+	/// \param name Dot separated path, e.g. "io.file" is a child of "io"
+	///
+	///////////////////////////////////////////////////////////
+	LogCategory(const char* name);
+
+	~LogCategory(void);
+
+	LogCategory(const LogCategory&) = delete;
+	LogCategory& operator=(const LogCategory&) = delete;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check if a level is logged for this category
+	///
+	/// A single relaxed load, the macros call it before the
+	/// message is built.
+	///
+	/// \param level Severity to check
+	///
+	/// \return True if entries of this level are logged
+	///
+	///////////////////////////////////////////////////////////
+	inline bool IsEnabled(LogLevel level) const
+	{
+		return static_cast<Byte>( level ) >= mLevel.load(std::memory_order_relaxed);
+	}
+
+	inline LogLevel GetLevel() const
+	{
+		return static_cast<LogLevel>( mLevel.load(std::memory_order_relaxed) );
+	}
+
+	inline const char* GetName() const
+	{
+		return mpName;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Set the level of this category and its children
+	///
+	/// Same as LogCategory::SetLevel(GetName(), level).
+	///
+	/// \param level Lowest level to log
+	///
+	///////////////////////////////////////////////////////////
+	inline void SetLevel(LogLevel level)
+	{
+		SetLevel(mpName, level);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Set the level of a category and its children
+	///
+	/// Children which have a level of their own keep it.
+	/// The level is remembered, so categories created later
+	/// pick it up too; it can be set before the category
+	/// exists, e.g. from a command line or config file.
+	///
+	/// \param name Category path, "" sets the level of every category
+	/// \param level Lowest level to log
+	///
+	///////////////////////////////////////////////////////////
+	static void SetLevel(const String& name, LogLevel level);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Let a category inherit its parent's level again
+	///
+	/// \param name Category path passed to SetLevel
+	///
+	///////////////////////////////////////////////////////////
+	static void ResetLevel(const String& name);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Find a category by name
+	///
+	/// \param name Full dot separated path
+	///
+	/// \return The category, null if none with the name exists
+	///
+	///////////////////////////////////////////////////////////
+	static const LogCategory* Find(const String& name);
+
+private:
+	friend struct priv::LogCategoryRegistry;
+
+	const char* mpName;
+	std::atomic<Byte> mLevel; // Effective level, only written when levels change
+};
+///////////////////////////////////////////////////////////
+/// \class LogCategory
+/// \brief Named subsystem with its own runtime log level
+///
+/// Lets one module log in detail while the rest of the
+/// program stays quiet. Entries logged through a category
+/// are filtered by the category's level instead of the
+/// Logger's, and their text carries the category name.
+///
+/// Without a level of its own a category uses its closest
+/// parent's, and finally the root level (DEBUG_LOG in
+/// debug builds, INFO_LOG with NDEBUG).
+///
+/// \code
+/// // Header
+/// KL_DECLARE_LOG_CATEGORY(LogIO);
+///
+/// // Source file
+/// KL_DEFINE_LOG_CATEGORY(LogIO, "io");
+///
+/// LogCategory::SetLevel("io", DEBUG_LOG); // Also enables "io.file" and so on
+/// KL_CDEBUGLOG(LogIO, "Opened " + path);
+/// \endcode
+///
+///////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////
+/// \brief Where a log call was made
+///
+/// The KL_* macros create one static instance per call
+/// site, entries only carry a pointer to it.
+///
+///////////////////////////////////////////////////////////
+struct SourceLocation
+{
+	const char* function; // Null along with file for entries read back from a log
+	const char* file;
+	UInt line;
+	const LogCategory* category; // Null unless logged with the KL_C* macros
+};
+
+class LogMessage
+{
+public:
+	LogMessage() : mSize(0) { mInline[0] = '\0'; }
+
+	LogMessage(const LogMessage& other) : mSize(0)
+	{
+		Assign(other.GetData(), other.mSize);
+	}
+
+	LogMessage(LogMessage&& other) : mSize(0)
+	{
+		*this = std::move(other);
+	}
+
+	LogMessage& operator=(const LogMessage& other)
+	{
+		if (this != &other)
+			Assign(other.GetData(), other.mSize);
+		return *this;
+	}
+
+	LogMessage& operator=(LogMessage&& other)
+	{
+		if (this == &other)
+			return *this;
+
+		if (other.IsInline())
+			Assign(other.mInline, other.mSize);
+		else
+		{
+			mLong = std::move(other.mLong);
+			mSize = other.mSize;
+		}
+		return *this;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Replace the message
+	///
+	/// Only allocates if the message doesn't fit inline.
+	///
+	/// \param data Characters, don't need to be null-terminated
+	/// \param size Number of characters
+	///
+	///////////////////////////////////////////////////////////
+	inline void Assign(const char* data, size_t size)
+	{
+		if (size < KL_LOG_INLINE_MESSAGE)
+		{
+			std::memcpy(mInline, data, size);
+			mInline[size] = '\0';
+		}
+		else
+		{
+			mLong.assign(data, size);
+		}
+		mSize = static_cast<UInt>( size );
+	}
+
+	inline void Assign(const String& message)
+	{
+		Assign(message.data(), message.size());
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the characters
+	///
+	/// \return Null-terminated message
+	///
+	///////////////////////////////////////////////////////////
+	inline const char* GetData() const
+	{
+		return IsInline() ? mInline : mLong.c_str();
+	}
+
+	inline UInt GetSize() const
+	{
+		return mSize;
+	}
+
+	inline bool IsInline() const
+	{
+		return mSize < KL_LOG_INLINE_MESSAGE;
+	}
+
+	inline String ToString() const
+	{
+		return String(GetData(), mSize);
+	}
+
+private:
+	char mInline[KL_LOG_INLINE_MESSAGE];
+	UInt mSize;
+	String mLong;
+};
+///////////////////////////////////////////////////////////
+/// \class LogMessage
+/// \brief Message text of a LogEntry with small-buffer storage
+///
+/// Copying and moving only touches the characters in use.
+///
+///////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////
+/// Number of encoded field bytes a LogEntry stores inline
+///
+/// Entries with more structured fields spill into a String.
+///
+///////////////////////////////////////////////////////////
+#if !defined(KL_LOG_INLINE_FIELDS)
+#	define KL_LOG_INLINE_FIELDS 128
+#endif
+
+enum LogFieldType
+{
+	FIELD_INT		= 0,	// Signed integer, stored as Long.
+	FIELD_UINT		= 1,	// Unsigned integer or bool, stored as ULong.
+	FIELD_FLOAT		= 2,	// Floating point, stored as Double.
+	FIELD_STRING	= 3,	// Characters, copied into the entry.
+	FIELD_DURATION	= 4		// std::chrono duration, stored as nanoseconds.
+};
+
+enum LogFormat
+{
+	LOG_FORMAT_TEXT		= 0,	// "timestamp [LEVEL] category: message key=value ...", one line each.
+	LOG_FORMAT_JSON		= 1,	// One JSON object per line.
+	LOG_FORMAT_BINARY	= 2		// Length-prefixed records, see LogEntry::Format.
+};
+
+struct LogField
+{
+	const char* key;
+	LogFieldType type;
+
+	union
+	{
+		Long integer;
+		ULong unsignedInteger;
+		Double real;
+		Long nanoseconds;
+	};
+
+	const char* text; // Only for FIELD_STRING, not null-terminated
+	UInt textSize;
+
+	LogField() : key(""), type(FIELD_INT), integer(0), text(nullptr), textSize(0) {}
+
+	template<typename T>
+	LogField(const char* key, T value, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type* = nullptr)
+		: key(key), type(FIELD_INT), integer(value), text(nullptr), textSize(0) {}
+
+	template<typename T>
+	LogField(const char* key, T value, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type* = nullptr)
+		: key(key), type(FIELD_UINT), unsignedInteger(value), text(nullptr), textSize(0) {}
+
+	template<typename T>
+	LogField(const char* key, T value, typename std::enable_if<std::is_floating_point<T>::value>::type* = nullptr)
+		: key(key), type(FIELD_FLOAT), real(value), text(nullptr), textSize(0) {}
+
+	template<typename Rep, typename Period>
+	LogField(const char* key, std::chrono::duration<Rep, Period> value)
+		: key(key), type(FIELD_DURATION), nanoseconds(std::chrono::duration_cast<std::chrono::nanoseconds>(value).count()),
+		text(nullptr), textSize(0) {}
+
+	LogField(const char* key, const char* value) // Null is logged as ""
+		: key(key), type(FIELD_STRING), integer(0), text(value ? value : ""), textSize(value ? static_cast<UInt>( std::strlen(value) ) : 0) {}
+
+	LogField(const char* key, const String& value)
+		: key(key), type(FIELD_STRING), integer(0), text(value.data()), textSize(static_cast<UInt>( value.size() )) {}
+};
+///////////////////////////////////////////////////////////
+/// \class LogField
+/// \brief Typed key/value pair attached to a log entry
+///
+/// Built implicitly from { "key", value }, the KL_S*
+/// macros take any number of them. Only references the
+/// key and text, which must stay alive for the Log() call;
+/// the logger copies the raw bytes, nothing is converted
+/// to text on the logging thread.
+///
+///////////////////////////////////////////////////////////
+
+class LogFields
+{
+public:
+	LogFields() : mSize(0) {}
+
+	LogFields(const LogFields& other) : mSize(0)
+	{
+		Append(other.GetData(), other.mSize);
+	}
+
+	LogFields(LogFields&& other) : mSize(0)
+	{
+		*this = std::move(other);
+	}
+
+	LogFields& operator=(const LogFields& other)
+	{
+		if (this != &other)
+		{
+			Clear();
+			Append(other.GetData(), other.mSize);
+		}
+		return *this;
+	}
+
+	LogFields& operator=(LogFields&& other)
+	{
+		if (this == &other)
+			return *this;
+
+		Clear();
+		if (other.IsInline())
+			Append(other.mInline, other.mSize);
+		else
+		{
+			mLong = std::move(other.mLong);
+			mSize = other.mSize;
+			other.Clear();
+		}
+		return *this;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Encode a field
+	///
+	/// Type byte, null-terminated key, then 8 value bytes, or
+	/// for strings a UInt size and the characters. Only
+	/// copies bytes, and only allocates once the fields no
+	/// longer fit inline.
+	///
+	/// \param field Field to append
+	///
+	///////////////////////////////////////////////////////////
+	void Add(const LogField& field);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Decode the field at a position
+	///
+	/// The key and text of the decoded field point into this
+	/// object.
+	///
+	/// \code
+	/// UInt position = 0;
+	/// LogField field;
+	/// while (entry.fields.Next(position, field))
+	///     Print(field.key);
+	/// \endcode
+	///
+	/// \param position Byte offset, start at 0; moved past the field
+	/// \param field Set to the decoded field
+	///
+	/// \return False once there are no more fields
+	///
+	///////////////////////////////////////////////////////////
+	bool Next(UInt& position, LogField& field) const;
+
+	inline void Clear()
+	{
+		mSize = 0;
+		mLong.clear();
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the encoded bytes
+	///
+	/// \return Fields in the encoding described by Add()
+	///
+	///////////////////////////////////////////////////////////
+	inline const char* GetData() const
+	{
+		return IsInline() ? mInline : mLong.data();
+	}
+
+	inline UInt GetSize() const
+	{
+		return mSize;
+	}
+
+	inline bool IsEmpty() const
+	{
+		return mSize == 0;
+	}
+
+	inline bool IsInline() const
+	{
+		return mLong.empty();
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Append already encoded fields
+	///
+	/// \param data Bytes in the encoding described by Add()
+	/// \param size Number of bytes
+	///
+	///////////////////////////////////////////////////////////
+	inline void Append(const char* data, size_t size)
+	{
+		if (IsInline() && mSize + size <= KL_LOG_INLINE_FIELDS)
+		{
+			std::memcpy(mInline + mSize, data, size);
+		}
+		else
+		{
+			if (IsInline())
+				mLong.assign(mInline, mSize);
+			mLong.append(data, size);
+		}
+		mSize += static_cast<UInt>( size );
+	}
+
+private:
+	char mInline[KL_LOG_INLINE_FIELDS];
+	UInt mSize;
+	String mLong; // Holds every byte once the fields don't fit inline
+};
+///////////////////////////////////////////////////////////
+/// \class LogFields
+/// \brief Binary encoded structured fields of a LogEntry
+///
+/// Copying and moving only touches the bytes in use.
+///
+///////////////////////////////////////////////////////////
+
 struct LogEntry
 {
 	LogLevel level; //Severity of error
-	String message; //Message of error, 'body'
-	ULong timestamp;
+	LogMessage message; //Message of error, 'body'
+	LogFields fields; //Structured key/value pairs, encoded
+	ULong timestamp; //Nanoseconds, or CycleClock ticks if clock is TIME_CYCLE_COUNTER
+	TimeSource clock;
 	
-	String sourceFunction;
-	String sourceFile;
-	UInt sourceLine;
+	const SourceLocation* source; //Static call site, may be null
 
-	String ToString(void) const
+	LogEntry() : level(DEBUG_LOG), timestamp(0), clock(TIME_SYSTEM_CLOCK), source(nullptr) {}
+
+	static const char* GetLevelName(LogLevel level)
 	{
-		String levelStr("Unkown");
 		switch (level)
 		{
-			case DEBUG_LOG: levelStr = "DEBUG"; break;
-			case INFO_LOG: levelStr = "INFO"; break;
-			case WARNING_LOG: levelStr = "WARNING"; break;
-			case ERROR_LOG: levelStr = "ERROR"; break;
-			case FATAL_LOG: levelStr = "FATAL"; break;
+			case DEBUG_LOG: return "DEBUG";
+			case INFO_LOG: return "INFO";
+			case WARNING_LOG: return "WARNING";
+			case ERROR_LOG: return "ERROR";
+			case FATAL_LOG: return "FATAL";
 		}
-		return klib::ToString(timestamp) + " [" + levelStr + "] " + message;
+		return "Unkown";
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the timestamp in nanoseconds since the unix epoch
+	///
+	/// Converts cycle counter ticks, so sinks never need to
+	/// know which clock stamped the entry.
+	///
+	/// \return Time the entry was logged
+	///
+	///////////////////////////////////////////////////////////
+	inline ULong GetNanoseconds() const
+	{
+		return ( clock == TIME_CYCLE_COUNTER ) ? time::CycleClock::ToNanoseconds(timestamp) : timestamp;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Append the text form of the entry to a String
+	///
+	/// Lets sinks reuse one String for many entries. Fields
+	/// follow the message as key=value.
+	///
+	/// \param out String to append to
+	///
+	///////////////////////////////////////////////////////////
+	void AppendTo(String& out) const;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Append the entry as one JSON object
+	///
+	/// Keys are "time" (nanoseconds), "level", "category" if
+	/// any, "message", "file" and "line" if known, then each
+	/// field. Durations are written as nanoseconds.
+	///
+	/// \param out String to append to
+	///
+	///////////////////////////////////////////////////////////
+	void AppendJson(String& out) const;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Append the entry as a length-prefixed binary record
+	///
+	/// Host byte order:
+	///     UInt size of the rest of the record
+	///     ULong nanoseconds, Byte level
+	///     UShort category size, category characters
+	///     UInt message size, message characters
+	///     UInt fields size, fields as encoded by LogFields
+	///
+	/// \param out String to append to
+	///
+	///////////////////////////////////////////////////////////
+	void AppendBinary(String& out) const;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Append the entry as a complete record
+	///
+	/// Text and JSON records end with a newline.
+	///
+	/// \param out String to append to
+	/// \param format Format to write
+	///
+	///////////////////////////////////////////////////////////
+	void Format(String& out, LogFormat format) const;
+
+	String ToString(void) const
+	{
+		String text;
+		AppendTo(text);
+		return text;
 	};
 };
 	
 class LogListener
 {
 public:
-	LogListener() : mEnabled(true) {}
+	LogListener() : mEnabled(true), mLevel(DEBUG_LOG) {}
 
-	virtual bool Log(LogEntry entry) = 0;
+	virtual ~LogListener() {}
 
-	bool IsEnabled() const { return mEnabled; }
-	void SetEnabled(bool enabled) { mEnabled = enabled; }
+	virtual bool Log(const LogEntry& entry) = 0;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Log several entries at once
+	///
+	/// Called by the background thread of an asynchronous
+	/// Logger with every entry it drained in one go.
+	/// The default calls Log() for each entry, listeners that
+	/// can batch their output (one write, one flush) should
+	/// override it.
+	///
+	/// \param entries Entries, oldest first
+	/// \param count Number of entries
+	///
+	/// \return False to stop later listeners seeing the batch
+	///
+	///////////////////////////////////////////////////////////
+	virtual bool LogBatch(const LogEntry* entries, UInt count)
+	{
+		bool result = true;
+		for (UInt i = 0; i < count; i++)
+			result = Log(entries[i]) && result;
+		return result;
+	}
+
+	bool IsEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+	void SetEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+
+	///////////////////////////////////////////////////////////
+	/// \brief Set the lowest level this listener receives
+	///
+	/// Lets one listener (say a file) ignore detail which
+	/// another (say a FlightRecorder) still keeps. The
+	/// Logger's own threshold is applied first.
+	///
+	/// \param level Lowest level passed to this listener
+	///
+	///////////////////////////////////////////////////////////
+	void SetLevel(LogLevel level) { mLevel.store(level, std::memory_order_relaxed); }
+	LogLevel GetLevel() const { return mLevel.load(std::memory_order_relaxed); }
 
 private:
-	bool mEnabled;
+	std::atomic<bool> mEnabled;
+	std::atomic<LogLevel> mLevel;
 };
 
-class Logger
+class API_EXPORT Logger
 {
 public:
-	Logger(){};
+	Logger();
 	virtual ~Logger(void);
 	
-	void Log(LogLevel level, String message, String func, String file, UInt line);
+	///////////////////////////////////////////////////////////
+	/// \brief Log a message
+	///
+	/// Messages shorter than KL_LOG_INLINE_MESSAGE are copied
+	/// into the entry itself, so nothing is allocated. If the
+	/// source has a category, its level is checked instead of
+	/// the logger's.
+	///
+	/// Fields are encoded as raw bytes, text conversion is
+	/// left to the listeners.
+	///
+	/// \param level Severity
+	/// \param source Static location of the call site
+	/// \param message Message characters
+	/// \param size Number of characters
+	/// \param fields Structured fields, may be null
+	/// \param fieldCount Number of fields
+	///
+	///////////////////////////////////////////////////////////
+	void Log(LogLevel level, const SourceLocation& source, const char* message, size_t size,
+		const LogField* fields = nullptr, UInt fieldCount = 0);
+
+	inline void Log(LogLevel level, const SourceLocation& source, const char* message,
+		const LogField* fields = nullptr, UInt fieldCount = 0)
+	{
+		Log(level, source, message, std::strlen(message), fields, fieldCount);
+	}
+
+	inline void Log(LogLevel level, const SourceLocation& source, const String& message,
+		const LogField* fields = nullptr, UInt fieldCount = 0)
+	{
+		Log(level, source, message.data(), message.size(), fields, fieldCount);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Log that a call site was rate limited
+	///
+	/// Logs "Last message repeated N times" for the site,
+	/// used by the KL_*_RATE macros.
+	///
+	/// \param level Severity of the suppressed entries
+	/// \param source Call site which was suppressed
+	/// \param count Number of entries which were dropped
+	///
+	///////////////////////////////////////////////////////////
+	void LogSuppressed(LogLevel level, const SourceLocation& source, UInt count);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Remember a rate limited call site
+	///
+	/// Its suppressed entries are then also reported by
+	/// FlushSuppressed(), not only once the site logs again.
+	/// The KL_*_RATE macros call this the first time a site
+	/// is suppressed; the limiter and source must outlive
+	/// the logger.
+	///
+	/// \param level Severity of the suppressed entries
+	/// \param source Call site
+	/// \param limiter Limiter of the call site
+	///
+	///////////////////////////////////////////////////////////
+	void TrackSuppressed(LogLevel level, const SourceLocation& source, RateLimiter& limiter);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Log the counts of suppressed entries now
+	///
+	/// Logs "Last message repeated N times" for every tracked
+	/// call site which dropped entries since it last logged.
+	/// In asynchronous mode the background thread does this
+	/// about once a second and when stopped, the destructor
+	/// does it too.
+	///
+	///////////////////////////////////////////////////////////
+	void FlushSuppressed();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check if entries of a level would be logged
+	///
+	/// A single relaxed load and compare, the KL_* macros
+	/// call this before building the message.
+	///
+	/// \param level Level to check
+	///
+	/// \return True if level is at or above the threshold
+	///
+	///////////////////////////////////////////////////////////
+	inline bool IsEnabled(LogLevel level) const
+	{
+		return static_cast<Byte>( level ) >= mLevel.load(std::memory_order_relaxed);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Set the runtime threshold
+	///
+	/// Entries below this level are discarded before anything
+	/// is allocated. Defaults to DEBUG_LOG in debug builds
+	/// and INFO_LOG in release builds (NDEBUG).
+	///
+	/// \param level Lowest level to log
+	///
+	///////////////////////////////////////////////////////////
+	inline void SetLevel(LogLevel level)
+	{
+		mLevel.store(static_cast<Byte>( level ), std::memory_order_relaxed);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the runtime threshold
+	///
+	/// \return Lowest level which is logged
+	///
+	///////////////////////////////////////////////////////////
+	inline LogLevel GetLevel() const
+	{
+		return static_cast<LogLevel>( mLevel.load(std::memory_order_relaxed) );
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Choose the clock entries are stamped with
+	///
+	/// TIME_CYCLE_COUNTER only reads the CPU cycle counter
+	/// when logging, which is far cheaper than the system
+	/// clock; the ticks are converted to nanoseconds when an
+	/// entry is formatted. Calibrates CycleClock the first
+	/// time, which takes a couple of milliseconds.
+	///
+	/// \param source Clock to use, TIME_SYSTEM_CLOCK by default
+	///
+	///////////////////////////////////////////////////////////
+	void SetTimeSource(TimeSource source);
+
+	inline TimeSource GetTimeSource() const
+	{
+		return static_cast<TimeSource>( mTimeSource.load(std::memory_order_relaxed) );
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Add a listener
+	///
+	/// \param listener Listener which will receive every entry
+	///
+	///////////////////////////////////////////////////////////
+	void AddListener(StrongPtr<LogListener> listener);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Remove a listener
+	///
+	/// Returns once no thread is still inside the listener
+	/// through this logger, so it can be destroyed right away.
+	///
+	/// \param listener Listener previously passed to AddListener
+	///
+	///////////////////////////////////////////////////////////
+	void RemoveListener(const StrongPtr<LogListener>& listener);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Switch to asynchronous logging
+	///
+	/// From now on Log() only pushes the entry onto a bounded
+	/// queue, and a background thread hands the entries to
+	/// the listeners in batches of up to 'batchSize'.
+	///
+	/// \param capacity Number of entries the queue can hold
+	/// \param policy What to do when the queue is full
+	/// \param batchSize Maximum entries passed to LogListener::LogBatch at once
+	///
+	/// \return False if already asynchronous
+	///
+	///////////////////////////////////////////////////////////
+	bool StartAsync(UInt capacity = 8192, OverflowPolicy policy = OVERFLOW_BLOCK, UInt batchSize = 256);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Switch back to synchronous logging
+	///
+	/// Stops the background thread once it has written every
+	/// queued entry.
+	///
+	///////////////////////////////////////////////////////////
+	void StopAsync();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check if the logger is asynchronous
+	///
+	/// \return True between StartAsync and StopAsync
+	///
+	///////////////////////////////////////////////////////////
+	inline bool IsAsync() const
+	{
+		return mpQueue.load(std::memory_order_acquire) != nullptr;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the number of entries lost to a full queue
+	///
+	/// Counts every entry dropped by OVERFLOW_DROP_NEWEST or
+	/// OVERFLOW_DROP_OLDEST, across all async sessions.
+	///
+	/// \return Dropped entries
+	///
+	///////////////////////////////////////////////////////////
+	ULong GetDroppedCount() const;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Hand entries to the listeners
+	///
+	/// Done on the calling thread; used by the background
+	/// thread in asynchronous mode.
+	///
+	/// \param entries Entries, oldest first
+	/// \param count Number of entries
+	///
+	///////////////////////////////////////////////////////////
+	void Dispatch(const LogEntry* entries, UInt count);
 	
 private:
-	ArrayList<StrongPtr<LogListener>> mListeners;
+	friend class priv::AsyncLogWorker;
+
+	typedef ArrayList<StrongPtr<LogListener>> ListenerList;
+
+	struct SuppressedSite
+	{
+		LogLevel level;
+		const SourceLocation* source;
+		RateLimiter* limiter;
+	};
+
+	void Stamp(LogEntry& entry) const;
+	void CollectSuppressed(ArrayList<LogEntry>& entries);
+	UInt EnterRead() const;
+	void ExitRead(UInt epoch) const;
+	void Synchronize();
+	static void DispatchTo(const ListenerList& listeners, const LogEntry* entries, UInt count);
+
+	std::atomic<Byte> mLevel;
+	std::atomic<Byte> mTimeSource;
+
+	// Readers (logging threads) never lock: they load an immutable snapshot of the
+	// listeners inside a read section. Writers publish a new snapshot and wait for
+	// the sections which could still see the old one before freeing it.
+	std::atomic<const ListenerList*> mpListeners;
+	std::atomic<UInt> mEpoch;
+	mutable std::atomic<UInt> mReaders[2];
+	mutable std::mutex mWriterMutex; // Serializes listener changes and StartAsync/StopAsync
+
+	std::atomic<LogQueue*> mpQueue;
+	priv::AsyncLogWorker* mpWorker;
+	ULong mDroppedBefore; // Dropped by queues of previous async sessions
+
+	std::mutex mSuppressedMutex; // Only taken when a site is first suppressed, and by FlushSuppressed
+	ArrayList<SuppressedSite> mSuppressedSites;
 };
+///////////////////////////////////////////////////////////
+/// \class Logger
+/// \brief Passes log entries on to a set of listeners
+///
+/// Synchronous by default: the listeners run on the thread
+/// that logs. After StartAsync() logging only costs a push
+/// onto a lock-free queue, and the listeners run on a
+/// background thread.
+///
+/// Thread-safe: any thread may log, add or remove listeners
+/// and start or stop asynchronous mode at any time. Logging
+/// never waits on listener changes, the listener list is
+/// copied on write and swapped in atomically. In synchronous
+/// mode listeners can be called from several threads at
+/// once, so they must be thread-safe themselves. A listener
+/// must not add or remove listeners from inside Log().
+///
+/// \code
+/// klib::DefaultLogger.AddListener(StrongPtr<LogListener>(new LogFileWriter("game.log")));
+/// klib::DefaultLogger.StartAsync(4096, klib::logging::OVERFLOW_DROP_OLDEST);
+/// \endcode
+///
+/// \see LogQueue, LogListener
+///
+///////////////////////////////////////////////////////////
 
 class ErrorMessenger : public LogListener
 {
 public:
-	virtual bool Log(LogEntry entry) = 0;
+	virtual bool Log(const LogEntry& entry) = 0;
 };
 
 class LogFileWriter : public LogListener
 {
 public:
-	LogFileWriter(String logFileName);
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// \param logFileName File to append to, created if needed
+	/// \param format How entries are written
+	///
+	///////////////////////////////////////////////////////////
+	LogFileWriter(String logFileName, LogFormat format = LOG_FORMAT_TEXT);
 	
 	virtual ~LogFileWriter(void);
 	
-	virtual bool Log(LogEntry entry) = 0;
+	virtual bool Log(const LogEntry& entry) override;
+
+	virtual bool LogBatch(const LogEntry* entries, UInt count) override;
 	
 private:
-	klib::io::TextFile logFile;
+	std::mutex mMutex;
+	LogFormat mFormat;
+	klib::io::TextFile* mpLogFile;
+	String mText;
 };
 
 } // logging
 
-static logging::Logger DefaultLogger;
+extern API_EXPORT logging::Logger DefaultLogger;
 
 } // klib
 
 
+#if defined(__GNUC__)
+#	define KL_LOG_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#	define KL_LOG_UNLIKELY(x) (x)
+#endif
+
+// Checks the runtime threshold before 'str' is evaluated
+#define KL_LOG_PRIV(level, str) \
+do \
+{ \
+	if (KL_LOG_UNLIKELY(klib::DefaultLogger.IsEnabled(level))) \
+	{ \
+		static const klib::logging::SourceLocation source = { __FUNCTION__, __FILE__, __LINE__, nullptr }; \
+		klib::DefaultLogger.Log(level, source, str); \
+	} \
+} \
+while (0) \
+
 #define KL_LOG(level, str) \
 do \
 { \
-	String s(str); \
 	klib::logging::LogLevel l(level); \
-	klib::DefaultLogger.Log(l, s, __FUNCTION__, __FILE__, __LINE__); \
+	if (l >= KL_LOG_MIN_LEVEL) \
+		KL_LOG_PRIV(l, str); \
 } \
 while (0) \
 
-#define KL_DEBUGLOG(str) \
+#if KL_LOG_MIN_LEVEL <= 0
+#	define KL_DEBUGLOG(str) KL_LOG_PRIV(klib::logging::LogLevel::DEBUG_LOG, str)
+#else
+#	define KL_DEBUGLOG(str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 1
+#	define KL_INFO(str) KL_LOG_PRIV(klib::logging::LogLevel::INFO_LOG, str)
+#else
+#	define KL_INFO(str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 2
+#	define KL_WARNING(str) KL_LOG_PRIV(klib::logging::LogLevel::WARNING_LOG, str)
+#else
+#	define KL_WARNING(str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 3
+#	define KL_ERROR(str) KL_LOG_PRIV(klib::logging::LogLevel::ERROR_LOG, str)
+#else
+#	define KL_ERROR(str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 4
+#	define KL_FATAL(str) KL_LOG_PRIV(klib::logging::LogLevel::FATAL_LOG, str)
+#else
+#	define KL_FATAL(str) do {} while (0)
+#endif
+
+// Like KL_LOG_PRIV, followed by LogField initializers: KL_SINFO("Served", {"path", path}, {"took", elapsed})
+#define KL_SLOG_PRIV(level, str, ...) \
 do \
 { \
-	String s(str); \
-	klib::DefaultLogger.Log(klib::logging::LogLevel::DEBUG_LOG, s, __FUNCTION__, __FILE__, __LINE__); \
+	if (KL_LOG_UNLIKELY(klib::DefaultLogger.IsEnabled(level))) \
+	{ \
+		static const klib::logging::SourceLocation source = { __FUNCTION__, __FILE__, __LINE__, nullptr }; \
+		const klib::logging::LogField fields[] = { __VA_ARGS__ }; \
+		klib::DefaultLogger.Log(level, source, str, fields, sizeof(fields) / sizeof(fields[0])); \
+	} \
 } \
 while (0) \
 
-#define KL_INFO(str) \
+#define KL_SLOG(level, str, ...) \
 do \
 { \
-	String s(str); \
-	klib::DefaultLogger.Log(klib::logging::LogLevel::INFO_LOG, s, __FUNCTION__, __FILE__, __LINE__); \
+	klib::logging::LogLevel l(level); \
+	if (l >= KL_LOG_MIN_LEVEL) \
+		KL_SLOG_PRIV(l, str, __VA_ARGS__); \
 } \
 while (0) \
 
-#define KL_WARNING(str) \
+#if KL_LOG_MIN_LEVEL <= 0
+#	define KL_SDEBUGLOG(str, ...) KL_SLOG_PRIV(klib::logging::LogLevel::DEBUG_LOG, str, __VA_ARGS__)
+#else
+#	define KL_SDEBUGLOG(str, ...) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 1
+#	define KL_SINFO(str, ...) KL_SLOG_PRIV(klib::logging::LogLevel::INFO_LOG, str, __VA_ARGS__)
+#else
+#	define KL_SINFO(str, ...) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 2
+#	define KL_SWARNING(str, ...) KL_SLOG_PRIV(klib::logging::LogLevel::WARNING_LOG, str, __VA_ARGS__)
+#else
+#	define KL_SWARNING(str, ...) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 3
+#	define KL_SERROR(str, ...) KL_SLOG_PRIV(klib::logging::LogLevel::ERROR_LOG, str, __VA_ARGS__)
+#else
+#	define KL_SERROR(str, ...) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 4
+#	define KL_SFATAL(str, ...) KL_SLOG_PRIV(klib::logging::LogLevel::FATAL_LOG, str, __VA_ARGS__)
+#else
+#	define KL_SFATAL(str, ...) do {} while (0)
+#endif
+
+// Declares a LogCategory global in a header, define it once with KL_DEFINE_LOG_CATEGORY
+#define KL_DECLARE_LOG_CATEGORY(var) extern klib::logging::LogCategory var
+
+#define KL_DEFINE_LOG_CATEGORY(var, name) klib::logging::LogCategory var(name)
+
+// Like KL_LOG_PRIV, but only the category's level is checked
+#define KL_CLOG_PRIV(category, level, str) \
 do \
 { \
-	String s(str); \
-	klib::DefaultLogger.Log(klib::logging::LogLevel::WARNING_LOG, s, __FUNCTION__, __FILE__, __LINE__); \
+	if (KL_LOG_UNLIKELY((category).IsEnabled(level))) \
+	{ \
+		static const klib::logging::SourceLocation source = { __FUNCTION__, __FILE__, __LINE__, &(category) }; \
+		klib::DefaultLogger.Log(level, source, str); \
+	} \
 } \
 while (0) \
 
-#define KL_ERROR(str) \
+#define KL_CLOG(category, level, str) \
 do \
 { \
-	String s(str); \
-	klib::DefaultLogger.Log(klib::logging::LogLevel::ERROR_LOG, s, __FUNCTION__, __FILE__, __LINE__); \
+	klib::logging::LogLevel l(level); \
+	if (l >= KL_LOG_MIN_LEVEL) \
+		KL_CLOG_PRIV(category, l, str); \
 } \
 while (0) \
 
-#define KL_FATAL(str) \
+#if KL_LOG_MIN_LEVEL <= 0
+#	define KL_CDEBUGLOG(category, str) KL_CLOG_PRIV(category, klib::logging::LogLevel::DEBUG_LOG, str)
+#else
+#	define KL_CDEBUGLOG(category, str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 1
+#	define KL_CINFO(category, str) KL_CLOG_PRIV(category, klib::logging::LogLevel::INFO_LOG, str)
+#else
+#	define KL_CINFO(category, str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 2
+#	define KL_CWARNING(category, str) KL_CLOG_PRIV(category, klib::logging::LogLevel::WARNING_LOG, str)
+#else
+#	define KL_CWARNING(category, str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 3
+#	define KL_CERROR(category, str) KL_CLOG_PRIV(category, klib::logging::LogLevel::ERROR_LOG, str)
+#else
+#	define KL_CERROR(category, str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 4
+#	define KL_CFATAL(category, str) KL_CLOG_PRIV(category, klib::logging::LogLevel::FATAL_LOG, str)
+#else
+#	define KL_CFATAL(category, str) do {} while (0)
+#endif
+
+// The expression is always evaluated, only the logging is filtered
+#define KL_ASSERT(expr) \
 do \
 { \
-	String s(str); \
-	klib::DefaultLogger.Log(klib::logging::LogLevel::FATAL_LOG, s, __FUNCTION__, __FILE__, __LINE__); \
+if (!(expr)) \
+{ \
+	KL_ERROR(#expr); \
+} \
 } \
 while (0) \
 
-#define KL_ASSERT(expr) \
+// Like KL_LOG_PRIV, but logs at most 'perSecond' entries per second from this call site
+#define KL_LOG_RATE_PRIV(level, perSecond, str) \
+do \
+{ \
+	if (KL_LOG_UNLIKELY(klib::DefaultLogger.IsEnabled(level))) \
+	{ \
+		static klib::logging::RateLimiter limiter(perSecond); \
+		static const klib::logging::SourceLocation source = { __FUNCTION__, __FILE__, __LINE__, nullptr }; \
+		UInt suppressed = 0; \
+		if (limiter.Allow(suppressed)) \
+		{ \
+			if (suppressed > 0) \
+				klib::DefaultLogger.LogSuppressed(level, source, suppressed); \
+			klib::DefaultLogger.Log(level, source, str); \
+		} \
+		else if (limiter.MarkTracked()) \
+		{ \
+			klib::DefaultLogger.TrackSuppressed(level, source, limiter); \
+		} \
+	} \
+} \
+while (0) \
+
+#define KL_LOG_RATE(level, perSecond, str) \
+do \
+{ \
+	klib::logging::LogLevel l(level); \
+	if (l >= KL_LOG_MIN_LEVEL) \
+		KL_LOG_RATE_PRIV(l, perSecond, str); \
+} \
+while (0) \
+
+#if KL_LOG_MIN_LEVEL <= 0
+#	define KL_DEBUGLOG_RATE(perSecond, str) KL_LOG_RATE_PRIV(klib::logging::LogLevel::DEBUG_LOG, perSecond, str)
+#else
+#	define KL_DEBUGLOG_RATE(perSecond, str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 1
+#	define KL_INFO_RATE(perSecond, str) KL_LOG_RATE_PRIV(klib::logging::LogLevel::INFO_LOG, perSecond, str)
+#else
+#	define KL_INFO_RATE(perSecond, str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 2
+#	define KL_WARNING_RATE(perSecond, str) KL_LOG_RATE_PRIV(klib::logging::LogLevel::WARNING_LOG, perSecond, str)
+#else
+#	define KL_WARNING_RATE(perSecond, str) do {} while (0)
+#endif
+
+#if KL_LOG_MIN_LEVEL <= 3
+#	define KL_ERROR_RATE(perSecond, str) KL_LOG_RATE_PRIV(klib::logging::LogLevel::ERROR_LOG, perSecond, str)
+#else
+#	define KL_ERROR_RATE(perSecond, str) do {} while (0)
+#endif
+
+// Rate-limited KL_ASSERT for checks inside hot paths, like the BinaryStream operators
+#define KL_ASSERT_RATE(expr, perSecond) \
 do \
 { \
 if (!(expr)) \
 { \
-	String s(#expr); \
-	klib::DefaultLogger.Log(klib::logging::LogLevel::ERROR_LOG, s, __FUNCTION__, __FILE__, __LINE__); \
+	KL_ERROR_RATE(perSecond, #expr); \
 } \
 } \
 while (0) \
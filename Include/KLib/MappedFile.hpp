@@ -0,0 +1,203 @@
+#pragma once
+
+#include <KLib/Config.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/File.hpp> // AccessHint
+
+namespace klib
+{
+namespace io
+{
+
+typedef Byte MapMode;
+
+namespace MapModes
+{
+enum : MapMode
+{
+	ReadOnly = 0, // Pages are read-only, writing to them crashes
+	CopyOnWrite = 1, // Writes go to private copies of the pages, the file is never changed
+	Shared = 2 // Writes go to the file and are seen by every process mapping it
+};
+}
+
+namespace priv
+{
+struct MappedFileHandle; // Platform handles, defined in MappedFile.cpp
+}
+
+class API_EXPORT MappedFile
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// Doesn't map anything, see Open().
+	///
+	///////////////////////////////////////////////////////////
+	MappedFile();
+
+	///////////////////////////////////////////////////////////
+	/// \brief 'Attempt-Open' Constructor
+	///
+	/// Use IsOpen() to check if the file was mapped.
+	///
+	/// \param path File to map
+	/// \param mode How the pages may be written
+	///
+	///////////////////////////////////////////////////////////
+	MappedFile(const String& path, MapMode mode = MapModes::ReadOnly);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Default Destructor
+	///
+	/// Unmaps the file. Changes to a Shared mapping reach the
+	/// file eventually, call Flush() to wait for them.
+	///
+	///////////////////////////////////////////////////////////
+	~MappedFile(void);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Map a file into memory
+	///
+	/// The whole file is mapped, nothing is read until a page
+	/// is touched. An empty file opens successfully with no
+	/// data.
+	///
+	/// \param path File to map
+	/// \param mode How the pages may be written
+	/// \param size For Shared mappings, create or grow the file to this size first (0 keeps its size)
+	///
+	/// \return True if the file was mapped
+	///
+	///////////////////////////////////////////////////////////
+	bool Open(const String& path, MapMode mode = MapModes::ReadOnly, ULong size = 0);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Unmap the file
+	///
+	///////////////////////////////////////////////////////////
+	void Close();
+
+	inline bool IsOpen() const
+	{
+		return mOpen;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the mapped bytes
+	///
+	/// \return First byte of the file, null if empty or not open
+	///
+	///////////////////////////////////////////////////////////
+	inline const char* GetData() const
+	{
+		return mpData;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the mapped bytes for writing
+	///
+	/// \return First byte of the file, null for ReadOnly mappings
+	///
+	///////////////////////////////////////////////////////////
+	inline char* GetWritableData()
+	{
+		return ( mMode != MapModes::ReadOnly ) ? mpData : nullptr;
+	}
+
+	inline ULong GetSize() const
+	{
+		return mSize;
+	}
+
+	inline MapMode GetMode() const
+	{
+		return mMode;
+	}
+
+	inline const String& GetPath() const
+	{
+		return mPath;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Tell the kernel how a range will be used
+	///
+	/// madvise on POSIX. On Windows WillNeed prefetches the
+	/// range, other hints are accepted and ignored.
+	///
+	/// \param hint Expected access pattern
+	/// \param offset First byte of the range
+	/// \param length Bytes in the range, 0 for the rest of the file
+	///
+	/// \return True if the hint was applied
+	///
+	///////////////////////////////////////////////////////////
+	bool Advise(AccessHint hint, ULong offset = 0, ULong length = 0);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Start reading a range in the background
+	///
+	/// Same as Advise(AccessHints::WillNeed, ...): returns
+	/// straight away, later page faults in the range find the
+	/// data already in memory.
+	///
+	/// \param offset First byte of the range
+	/// \param length Bytes in the range, 0 for the rest of the file
+	///
+	/// \return True if the prefetch was started
+	///
+	///////////////////////////////////////////////////////////
+	inline bool Prefetch(ULong offset, ULong length = 0)
+	{
+		return Advise(AccessHints::WillNeed, offset, length);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write changes of a Shared mapping to the file
+	///
+	/// \param wait Block until the data is on disk, otherwise only schedule it
+	///
+	/// \return True if successful, always true for other modes
+	///
+	///////////////////////////////////////////////////////////
+	bool Flush(bool wait = true);
+
+private:
+	bool mOpen;
+	MapMode mMode;
+	String mPath;
+	char* mpData;
+	ULong mSize;
+	priv::MappedFileHandle* mpHandle;
+};
+///////////////////////////////////////////////////////////
+/// \class MappedFile
+/// \brief A file mapped into memory
+/// \ingroup FileIO
+///
+/// Reading through a mapping needs no syscalls and no copy
+/// into a user buffer: pages are faulted in straight from
+/// the page cache. For large files read front to back this
+/// runs at memory bandwidth, where iostream reads are
+/// bound by per-call overhead.
+///
+/// \code
+/// MappedFile file("assets.pak");
+/// file.Advise(AccessHints::Sequential);
+/// BinaryStream stream(file);
+/// stream >> header;
+/// const char* blob = stream.ReadView(header.blobSize); // no copy
+/// \endcode
+///
+/// \see BinaryStream, BinaryFile
+///
+///////////////////////////////////////////////////////////
+
+} // io
+} // klib
@@ -0,0 +1,572 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <ios> // seekdir
+#include <memory>
+#include <type_traits>
+#include <utility> // std::move
+
+#include <KLib/Config.hpp>
+#include <KLib/ArrayList.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/ByteBuffer.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+class API_EXPORT GrowableMemory
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// \param capacity Bytes to allocate up front, saves regrowing if the size is known
+	///
+	///////////////////////////////////////////////////////////
+	GrowableMemory(size_t capacity = 0)
+		: mpData(capacity > 0 ? new char[capacity] : nullptr), mSize(0), mCapacity(capacity) {}
+
+	GrowableMemory(GrowableMemory&& other)
+		: mpData(std::move(other.mpData)), mSize(other.mSize), mCapacity(other.mCapacity)
+	{
+		other.mSize = other.mCapacity = 0;
+	}
+
+	GrowableMemory& operator=(GrowableMemory&& other)
+	{
+		if (this != &other)
+		{
+			mpData = std::move(other.mpData);
+			mSize = other.mSize;
+			mCapacity = other.mCapacity;
+			other.mSize = other.mCapacity = 0;
+		}
+		return *this;
+	}
+
+	inline const char* GetData() const
+	{
+		return mpData.get();
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the number of bytes written
+	///
+	///////////////////////////////////////////////////////////
+	inline size_t GetSize() const
+	{
+		return mSize;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Make room to write at a position
+	///
+	/// \return Where to write, never null
+	///
+	///////////////////////////////////////////////////////////
+	inline char* GetWritable(size_t position, size_t bytes)
+	{
+		size_t end = position + bytes;
+		if (end > mCapacity)
+			Grow(end);
+		if (end > mSize)
+			mSize = end;
+		return mpData.get() + position;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Forget the contents, keeping the memory
+	///
+	///////////////////////////////////////////////////////////
+	inline void Clear()
+	{
+		mSize = 0;
+	}
+
+private:
+	// Out of the inlined path, it only runs a few times per stream
+	void Grow(size_t needed)
+	{
+		size_t capacity = std::max<size_t>(std::max<size_t>(mCapacity * 2, needed), 256);
+		std::unique_ptr<char[]> data(new char[capacity]);
+		if (mSize > 0)
+			std::memcpy(data.get(), mpData.get(), mSize);
+
+		mpData.swap(data);
+		mCapacity = capacity;
+	}
+
+	std::unique_ptr<char[]> mpData;
+	size_t mSize; // Bytes written, reads stop here
+	size_t mCapacity;
+};
+///////////////////////////////////////////////////////////
+/// \class GrowableMemory
+/// \brief MemoryStream backend owning a buffer that grows as it is written
+/// \ingroup FileIO
+///
+/// \see BasicMemoryStream, SpanMemory
+///
+///////////////////////////////////////////////////////////
+
+class API_EXPORT SpanMemory
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Writable span Constructor
+	///
+	/// \param data Memory to read and write, must outlive the stream
+	/// \param size Bytes in it; writes can't go further
+	///
+	///////////////////////////////////////////////////////////
+	SpanMemory(void* data, size_t size)
+		: mpData(static_cast<char*>( data )), mpWritableData(static_cast<char*>( data )), mSize(size) {}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read-only span Constructor
+	///
+	///////////////////////////////////////////////////////////
+	SpanMemory(const void* data, size_t size)
+		: mpData(static_cast<const char*>( data )), mpWritableData(nullptr), mSize(size) {}
+
+	SpanMemory(const ByteBuffer& buffer)
+		: mpData(buffer), mpWritableData(buffer), mSize(static_cast<size_t>( buffer.GetSize() )) {}
+
+	inline const char* GetData() const
+	{
+		return mpData;
+	}
+
+	inline size_t GetSize() const
+	{
+		return mSize;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get where to write at a position
+	///
+	/// \return Null if read-only or there isn't room
+	///
+	///////////////////////////////////////////////////////////
+	inline char* GetWritable(size_t position, size_t bytes)
+	{
+		if (!mpWritableData || bytes > mSize - position)
+			return nullptr;
+		return mpWritableData + position;
+	}
+
+private:
+	const char* mpData;
+	char* mpWritableData; // Null for read-only spans
+	size_t mSize;
+};
+///////////////////////////////////////////////////////////
+/// \class SpanMemory
+/// \brief MemoryStream backend over a fixed block of someone else's memory
+/// \ingroup FileIO
+///
+/// \see BasicMemoryStream, GrowableMemory
+///
+///////////////////////////////////////////////////////////
+
+template<typename Backend>
+class BasicMemoryStream
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// Only for backends that can be made without arguments,
+	/// e.g. an empty GrowableMemory.
+	///
+	///////////////////////////////////////////////////////////
+	BasicMemoryStream()
+		: mPosition(0), mFailed(false) {}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Backend Constructor
+	///
+	/// \code
+	/// char packet[1500];
+	/// SpanStream stream(SpanMemory(packet, sizeof(packet)));
+	/// MemoryStream out(GrowableMemory(1 << 20)); // Reserve 1MB
+	/// \endcode
+	///
+	/// \param backend Moved into the stream
+	///
+	///////////////////////////////////////////////////////////
+	explicit BasicMemoryStream(Backend backend)
+		: mBackend(std::move(backend)), mPosition(0), mFailed(false) {}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the size of the stream
+	///
+	/// \return Bytes written for a GrowableMemory, the span's size for a SpanMemory
+	///
+	///////////////////////////////////////////////////////////
+	inline ULong GetSize() const
+	{
+		return mBackend.GetSize();
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the start of the memory
+	///
+	/// Valid until the next write, which may move a growable
+	/// buffer.
+	///
+	///////////////////////////////////////////////////////////
+	inline const char* GetData() const
+	{
+		return mBackend.GetData();
+	}
+
+	inline Backend& GetBackend()
+	{
+		return mBackend;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check that no read or write has failed
+	///
+	/// A failed read or write fails the ones after it too,
+	/// until Seek() or Skip().
+	///
+	///////////////////////////////////////////////////////////
+	inline bool IsHealthy() const
+	{
+		return !mFailed;
+	}
+
+	inline operator bool() const
+	{
+		return IsHealthy();
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Move pointer to a new position
+	///
+	/// \param pos Position to move pointer to
+	/// \param way Optional direction to move from
+	///
+	/// \return False if outside the stream
+	///
+	///////////////////////////////////////////////////////////
+	inline bool Seek(ULong pos, std::ios::seekdir way = std::ios::beg)
+	{
+		ULong base = ( way == std::ios::cur ) ? mPosition : ( way == std::ios::end ) ? GetSize() : 0;
+		return SeekTo(base, static_cast<Long>( pos ));
+	}
+
+	inline bool Skip(Long amount)
+	{
+		return SeekTo(mPosition, amount);
+	}
+
+	inline ULong Tell() const
+	{
+		return mPosition;
+	}
+
+	inline bool IsEnd() const
+	{
+		return mPosition >= GetSize();
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read raw bytes without copying them
+	///
+	/// \param bytes Number of bytes to read
+	///
+	/// \return First byte, null if there aren't enough bytes left
+	///
+	///////////////////////////////////////////////////////////
+	inline const char* ReadView(size_t bytes)
+	{
+		if (mFailed || bytes > GetSize() - mPosition)
+		{
+			mFailed = true;
+			return nullptr;
+		}
+
+		const char* data = mBackend.GetData() + mPosition;
+		mPosition += bytes;
+		return data;
+	}
+
+	inline bool Read(char* buffer, size_t bytes)
+	{
+		const char* data = ReadView(bytes);
+		if (data)
+			std::memcpy(buffer, data, bytes);
+		return data != nullptr;
+	}
+
+	inline bool Write(const char* data, size_t bytes)
+	{
+		char* target = mFailed ? nullptr : mBackend.GetWritable(static_cast<size_t>( mPosition ), bytes);
+		if (!target)
+		{
+			mFailed = true;
+			return false;
+		}
+
+		std::memcpy(target, data, bytes);
+		mPosition += bytes;
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read from stream
+	///
+	/// Same formats as BinaryStream: basic types as their
+	/// bytes, arrays, Strings and ByteBuffers after a UInt
+	/// length.
+	///
+	///////////////////////////////////////////////////////////
+	template<typename T = String>
+	inline BasicMemoryStream& operator>>(T& data)
+	{
+		Read(reinterpret_cast<char*>( &data ), sizeof(T));
+		return *this;
+	}
+
+	template<typename T, typename Array = ArrayList<T>>
+	inline BasicMemoryStream& operator>>(Array& data)
+	{
+		UInt length = 0;
+		*this >> length;
+
+		data.clear();
+		for (UInt i = 0; i < length && !mFailed; i++)
+		{
+			T value;
+			*this >> value;
+			data.push_back(value);
+		}
+
+		return *this;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Read an ArrayList
+	///
+	/// Sized once from the length prefix, then one memcpy for
+	/// basic types and plain structs.
+	///
+	///////////////////////////////////////////////////////////
+	template<typename T>
+	inline BasicMemoryStream& operator>>(ArrayList<T>& data)
+	{
+		UInt length = 0;
+		*this >> length;
+
+		data.clear();
+
+		// Every element takes at least a byte, so a corrupt length can't make us allocate gigabytes
+		ULong minimum = static_cast<ULong>( length ) * ( klib::priv::IsBulkCopyable<T>::value ? sizeof(T) : 1 );
+		if (mFailed || minimum > GetSize() - mPosition)
+		{
+			mFailed = true;
+			return *this;
+		}
+
+		ReadElements(data, length, klib::priv::IsBulkCopyable<T>());
+		return *this;
+	}
+
+	template<typename T = ByteBuffer>
+	inline BasicMemoryStream& operator>>(ByteBuffer& data)
+	{
+		UInt length = 0;
+		*this >> length;
+
+		const char* bytes = ReadView(length);
+		data = ByteBuffer(bytes ? length : 0);
+		if (bytes && length > 0)
+			std::memcpy(data, bytes, length);
+
+		return *this;
+	}
+
+	template<typename T = String>
+	inline BasicMemoryStream& operator>>(String& data)
+	{
+		UInt length = 0;
+		*this >> length;
+
+		// Straight from the memory, no ByteBuffer in between
+		const char* characters = ReadView(length);
+		if (characters)
+			data.assign(characters, length);
+		else
+			data.clear();
+
+		return *this;
+	}
+
+	inline BasicMemoryStream& operator>>(char* data)
+	{
+		UInt length = 0;
+		*this >> length;
+
+		if (length > 0 && Read(data, length))
+			data[length] = '\0';
+
+		return *this;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Write to stream
+	///
+	/// Inlines to a bounds check and a memcpy for basic types.
+	///
+	///////////////////////////////////////////////////////////
+	template<typename T>
+	inline BasicMemoryStream& operator<<(const T& data)
+	{
+		Write(reinterpret_cast<const char*>( &data ), sizeof(T));
+		return *this;
+	}
+
+	template<typename T, typename Array = ArrayList<T>>
+	inline BasicMemoryStream& operator<<(const Array& data)
+	{
+		*this << static_cast<UInt>( data.size() );
+		for (const T& value : data)
+			*this << value;
+
+		return *this;
+	}
+
+	template<typename T>
+	inline BasicMemoryStream& operator<<(const ArrayList<T>& data)
+	{
+		*this << static_cast<UInt>( data.size() );
+		WriteElements(data, klib::priv::IsBulkCopyable<T>());
+		return *this;
+	}
+
+	template<typename T = ByteBuffer>
+	inline BasicMemoryStream& operator<<(const ByteBuffer& data)
+	{
+		UInt length = static_cast<UInt>( data.GetSize() );
+		*this << length;
+		if (length > 0)
+			Write(data, length);
+
+		return *this;
+	}
+
+	template<typename T = String>
+	inline BasicMemoryStream& operator<<(const String& data)
+	{
+		UInt length = static_cast<UInt>( data.size() );
+		*this << length;
+		if (length > 0)
+			Write(data.data(), length);
+
+		return *this;
+	}
+
+	inline BasicMemoryStream& operator<<(const char* data)
+	{
+		UInt length = static_cast<UInt>( std::strlen(data) );
+		*this << length;
+		if (length > 0)
+			Write(data, length);
+
+		return *this;
+	}
+
+private:
+	template<typename T>
+	inline void ReadElements(ArrayList<T>& data, UInt length, std::true_type)
+	{
+		const char* bytes = ReadView(static_cast<size_t>( length ) * sizeof(T));
+		data.resize(length);
+		if (length > 0)
+			std::memcpy(data.data(), bytes, static_cast<size_t>( length ) * sizeof(T));
+	}
+
+	template<typename T>
+	inline void ReadElements(ArrayList<T>& data, UInt length, std::false_type)
+	{
+		data.reserve(length);
+		for (UInt i = 0; i < length && !mFailed; i++)
+		{
+			T value;
+			*this >> value;
+			data.push_back(std::move(value));
+		}
+	}
+
+	template<typename T>
+	inline void WriteElements(const ArrayList<T>& data, std::true_type)
+	{
+		if (!data.empty())
+			Write(reinterpret_cast<const char*>( data.data() ), data.size() * sizeof(T));
+	}
+
+	template<typename T>
+	inline void WriteElements(const ArrayList<T>& data, std::false_type)
+	{
+		for (const T& value : data)
+			*this << value;
+	}
+
+	inline bool SeekTo(ULong base, Long offset)
+	{
+		Long position = static_cast<Long>( base ) + offset;
+		if (position < 0 || static_cast<ULong>( position ) > GetSize())
+		{
+			mFailed = true;
+			return false;
+		}
+
+		mPosition = static_cast<ULong>( position );
+		mFailed = false; // Like clear() + seekg()
+		return true;
+	}
+
+	Backend mBackend;
+	ULong mPosition;
+	bool mFailed;
+};
+///////////////////////////////////////////////////////////
+/// \class BasicMemoryStream
+/// \brief BinaryStream's reads and writes, straight on memory
+/// \ingroup FileIO
+///
+/// BinaryStream works on a std::iostream, so serializing
+/// into memory with it means a std::stringstream: every
+/// value goes through virtual streambuf calls, a sentry and
+/// a state check. Here the memory is a template parameter,
+/// so writing a basic type inlines to a bounds check and a
+/// memcpy. What is written reads back with BinaryStream and
+/// the other way round.
+///
+/// \code
+/// MemoryStream out;
+/// out << UInt(7) << String("player") << position;
+/// file.Write(out.GetData(), static_cast<UInt>( out.GetSize() ));
+///
+/// SpanStream in(SpanMemory(packet, packetSize));
+/// in >> id >> name >> position;
+/// if (!in)
+///     KL_WARNING("Malformed packet");
+/// \endcode
+///
+/// \see BinaryStream, GrowableMemory, SpanMemory
+///
+///////////////////////////////////////////////////////////
+
+typedef BasicMemoryStream<GrowableMemory> MemoryStream;
+typedef BasicMemoryStream<SpanMemory> SpanStream;
+
+} // io
+} // klib
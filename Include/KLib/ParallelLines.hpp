@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include <KLib/Config.hpp>
+#include <KLib/ArrayList.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/StringView.hpp>
+#include <KLib/File.hpp>
+#include <KLib/LineReader.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+struct API_EXPORT FileRange
+{
+	ULong offset;
+	ULong size;
+};
+
+///////////////////////////////////////////////////////////
+/// \brief Split a file into ranges of whole lines
+///
+/// Cuts the file into roughly equal parts, then moves each
+/// cut forward to just after the next newline. Only a few
+/// bytes around each cut are read.
+///
+/// \param path File to split
+/// \param parts Number of ranges wanted, fewer are returned for small files
+///
+/// \return Ranges in file order, covering the whole file; empty if it can't be opened
+///
+///////////////////////////////////////////////////////////
+API_EXPORT ArrayList<FileRange> SplitAtLines(const String& path, UInt parts);
+
+///////////////////////////////////////////////////////////
+/// \brief Map and reduce the lines of a file on every core
+///
+/// The file is split with SplitAtLines into more ranges
+/// than threads, so a slow range doesn't hold up the rest.
+/// Each thread opens its own TextFile and reads its ranges
+/// with a LineReader. Every range starts from a copy of
+/// 'initial' and map() folds its lines into it; the range
+/// results are then reduced in file order on the calling
+/// thread, so reduce() only has to be associative.
+///
+/// \code
+/// Long sum = ProcessLines<Long>("numbers.txt", 0,
+///     [](Long& sum, const StringView& line) { sum += FromString<Long>(line); },
+///     [](Long& total, const Long& part) { total += part; });
+/// \endcode
+///
+/// \param path Text file to process
+/// \param initial Starting value of every range's result and of the total, e.g. 0 for a sum
+/// \param map void(Result&, const StringView& line), called concurrently for different ranges
+/// \param reduce void(Result& total, const Result& range)
+/// \param threads Worker threads, 0 for one per core
+///
+/// \return Reduced result, 'initial' if the file is empty or can't be opened
+///
+///////////////////////////////////////////////////////////
+template<typename Result, typename Map, typename Reduce>
+Result ProcessLines(const String& path, const Result& initial, Map map, Reduce reduce, UInt threads = 0)
+{
+	if (threads == 0)
+		threads = std::max<UInt>(std::thread::hardware_concurrency(), 1);
+
+	ArrayList<FileRange> ranges = SplitAtLines(path, threads * 4);
+	if (ranges.empty())
+		return initial;
+
+	ArrayList<Result> results(ranges.size(), initial);
+	std::atomic<UInt> next(0);
+
+	auto worker = [&]()
+	{
+		TextFile file(path, FileModes::Read | FileModes::Binary); // Binary, so offsets are bytes everywhere
+
+		for (UInt index = next++; index < ranges.size(); index = next++)
+		{
+			file.GetStream().clear();
+			file.Seek(ranges[index].offset);
+
+			LineReader reader(file, 256 * 1024, ranges[index].size);
+			StringView line;
+			while (reader.Next(line))
+				map(results[index], line);
+		}
+	};
+
+	threads = std::min<UInt>(threads, static_cast<UInt>( ranges.size() ));
+
+	ArrayList<std::thread> pool;
+	for (UInt i = 1; i < threads; i++)
+		pool.push_back(std::thread(worker));
+	worker(); // The calling thread works too
+
+	for (std::thread& thread : pool)
+		thread.join();
+
+	Result total = initial;
+	for (const Result& result : results)
+		reduce(total, result);
+
+	return total;
+}
+
+} // io
+} // klib
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include <KLib/Config.hpp>
+#include <KLib/Number.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+class API_EXPORT RateLimiter
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// constexpr, so a static RateLimiter is set up at compile
+	/// time and the macros pay no guard for it.
+	///
+	/// \param perSecond Number of events allowed per second, also the size of a burst
+	///
+	///////////////////////////////////////////////////////////
+	constexpr RateLimiter(UInt perSecond)
+		: mInterval(1000000000ULL / ( perSecond > 0 ? perSecond : 1 )), mBurst(1000000000ULL),
+		mArrival(0), mSuppressed(0), mTracked(false) {}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check if another event is allowed now
+	///
+	/// Lock-free, safe to call from any number of threads.
+	/// Every rejected event is counted, and the count is
+	/// handed back (and reset) by the next allowed one.
+	///
+	/// \param suppressed Set to the number of events rejected since the last allowed one
+	///
+	/// \return True if the event is allowed
+	///
+	///////////////////////////////////////////////////////////
+	inline bool Allow(UInt& suppressed)
+	{
+		ULong now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+
+		// Generic cell rate algorithm: the token bucket is a single 'theoretical arrival time'
+		ULong arrival = mArrival.load(std::memory_order_relaxed);
+		while (true)
+		{
+			ULong next = ( arrival > now ? arrival : now ) + mInterval;
+			if (next > now + mBurst)
+			{
+				mSuppressed.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			if (mArrival.compare_exchange_weak(arrival, next, std::memory_order_relaxed))
+				break;
+		}
+
+		suppressed = mSuppressed.exchange(0, std::memory_order_relaxed);
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Take the events rejected so far
+	///
+	/// For reporting them without waiting for the next
+	/// allowed event, which then only gets the newer ones.
+	///
+	/// \return Number of events rejected since the last Allow() or TakeSuppressed()
+	///
+	///////////////////////////////////////////////////////////
+	inline UInt TakeSuppressed()
+	{
+		return mSuppressed.exchange(0, std::memory_order_relaxed);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Mark the limiter as tracked by a Logger
+	///
+	/// \return True only for the first call
+	///
+	///////////////////////////////////////////////////////////
+	inline bool MarkTracked()
+	{
+		return !mTracked.load(std::memory_order_relaxed) && !mTracked.exchange(true, std::memory_order_relaxed);
+	}
+
+private:
+	const ULong mInterval; // Nanoseconds of budget each event uses
+	const ULong mBurst; // Budget which can be used up at once
+	std::atomic<ULong> mArrival;
+	std::atomic<UInt> mSuppressed;
+	std::atomic<bool> mTracked;
+};
+///////////////////////////////////////////////////////////
+/// \class RateLimiter
+/// \brief Lock-free token bucket for limiting how often something happens
+///
+/// Used by the KL_*_RATE macros, which keep one static
+/// RateLimiter per call site so a warning firing in a
+/// tight loop can't flood the logger.
+///
+/// \code
+/// static RateLimiter limiter(10); // 10 per second
+/// UInt suppressed;
+/// if (limiter.Allow(suppressed))
+///     Send();
+/// \endcode
+///
+///////////////////////////////////////////////////////////
+
+} // logging
+} // klib
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <mutex>
+
+#include <KLib/Config.hpp>
+#include <KLib/LinkedList.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+#include <KLib/Memory.hpp>
+#include <KLib/Logging.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+class LogCompressor; // Forward declaration
+
+namespace priv
+{
+class MappedSegment;
+}
+
+class API_EXPORT RotatingLogWriter : public LogListener
+{
+public:
+	///////////////////////////////////////////////////////////
+	/// \brief Default Constructor
+	///
+	/// Opens the first segment straight away. Segments are
+	/// named basePath.0, basePath.1, ..., numbering carries
+	/// on from any segments already on disk.
+	///
+	/// \param basePath Path the segment number is appended to
+	/// \param segmentSize Size each segment is preallocated to, in bytes
+	/// \param keepSegments Number of segments kept on disk, including the active one (0 keeps all)
+	/// \param rolloverSeconds Start a new segment after this many seconds (0 only rolls over by size)
+	/// \param format How entries are written
+	///
+	///////////////////////////////////////////////////////////
+	RotatingLogWriter(String basePath, ULong segmentSize = 16 * 1024 * 1024, UInt keepSegments = 8, ULong rolloverSeconds = 0,
+		LogFormat format = LOG_FORMAT_TEXT);
+
+	///////////////////////////////////////////////////////////
+	/// \brief Default Destructor
+	///
+	/// Unmaps the active segment and trims it to the bytes
+	/// that were written.
+	///
+	///////////////////////////////////////////////////////////
+	virtual ~RotatingLogWriter(void);
+
+	virtual bool Log(const LogEntry& entry) override;
+
+	virtual bool LogBatch(const LogEntry* entries, UInt count) override;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Close the active segment and start a new one
+	///
+	/// \return True if the new segment could be created
+	///
+	///////////////////////////////////////////////////////////
+	bool Rotate();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Ask the OS to write the mapped pages out
+	///
+	/// Not needed for the data to survive a crash of the
+	/// process, only for a crash of the machine.
+	///
+	///////////////////////////////////////////////////////////
+	void Flush();
+
+	///////////////////////////////////////////////////////////
+	/// \brief Check if a segment is mapped and being written
+	///
+	/// \return True if entries are being written
+	///
+	///////////////////////////////////////////////////////////
+	bool IsOpen() const;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get the path of the active segment
+	///
+	/// \return Segment path, empty if none is open
+	///
+	///////////////////////////////////////////////////////////
+	String GetSegmentPath() const;
+
+	///////////////////////////////////////////////////////////
+	/// \brief Compress segments once they are closed
+	///
+	/// Each segment is handed to the compressor once closed,
+	/// including the last one when the writer is destroyed;
+	/// the compressor replaces it with a compressed copy.
+	/// Compressed segments count towards keepSegments.
+	///
+	/// \param compressor Compressor to use, null to stop compressing
+	///
+	///////////////////////////////////////////////////////////
+	void SetCompressor(StrongPtr<LogCompressor> compressor);
+
+private:
+	bool OpenSegment();
+	void CloseSegment();
+	String GetPath(UInt index) const;
+
+	String mBasePath;
+	ULong mSegmentSize;
+	UInt mKeepSegments;
+	ULong mRolloverSeconds;
+	LogFormat mFormat;
+
+	mutable std::mutex mMutex;
+	priv::MappedSegment* mpSegment;
+	ULong mOffset; // Bytes written into the active segment
+	ULong mSegmentStarted; // Wall-clock seconds when the active segment was opened
+	UInt mNextIndex;
+	LinkedList<UInt> mSegments; // Indices on disk, oldest first
+	StrongPtr<LogCompressor> mCompressor;
+	String mText;
+};
+///////////////////////////////////////////////////////////
+/// \class RotatingLogWriter
+/// \brief Writes log entries into preallocated, memory-mapped segments
+///
+/// Every segment is allocated on disk to its full size up
+/// front (fallocate) and mapped into memory. Logging
+/// copies the formatted entry into the mapping, so there
+/// is no write or flush syscall per entry and the file
+/// never grows piece by piece.
+///
+/// A new segment is started when the current one is full
+/// or older than the rollover interval; the oldest ones
+/// are deleted so at most 'keepSegments' stay on disk.
+///
+/// \code
+/// // 64MB segments, keep the last 4, start a new one every hour
+/// klib::DefaultLogger.AddListener(StrongPtr<LogListener>(
+///     new RotatingLogWriter("server.log", 64 * 1024 * 1024, 4, 60 * 60)));
+/// \endcode
+///
+/// \see LogFileWriter, LogCompressor
+///
+///////////////////////////////////////////////////////////
+
+} // logging
+} // klib
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstring>
+#include <cstdlib> // strtod
+#include <ostream>
+#include <type_traits> // std::make_unsigned
+
+#include <KLib/Config.hpp>
+#include <KLib/Number.hpp>
+#include <KLib/String.hpp>
+
+namespace klib
+{
+
+class API_EXPORT StringView
+{
+public:
+	StringView()
+		: mpData(nullptr), mSize(0) {}
+
+	StringView(const char* data, size_t size)
+		: mpData(data), mSize(size) {}
+
+	StringView(const char* str)
+		: mpData(str), mSize(str ? std::strlen(str) : 0) {}
+
+	StringView(const String& str)
+		: mpData(str.data()), mSize(str.size()) {}
+
+	inline const char* data() const
+	{
+		return mpData;
+	}
+
+	inline size_t size() const
+	{
+		return mSize;
+	}
+
+	inline bool empty() const
+	{
+		return mSize == 0;
+	}
+
+	inline const char* begin() const
+	{
+		return mpData;
+	}
+
+	inline const char* end() const
+	{
+		return mpData + mSize;
+	}
+
+	inline char operator[](size_t index) const
+	{
+		return mpData[index];
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Get part of the view
+	///
+	/// \param position First character
+	/// \param count Number of characters, clamped to the end
+	///
+	/// \return View of the same characters, no copy is made
+	///
+	///////////////////////////////////////////////////////////
+	inline StringView Substr(size_t position, size_t count = String::npos) const
+	{
+		if (position > mSize)
+			position = mSize;
+		if (count > mSize - position)
+			count = mSize - position;
+		return StringView(mpData + position, count);
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Find a character
+	///
+	/// \param c Character to find
+	/// \param position Where to start looking
+	///
+	/// \return Index of the character, String::npos if not found
+	///
+	///////////////////////////////////////////////////////////
+	inline size_t Find(char c, size_t position = 0) const
+	{
+		if (position >= mSize)
+			return String::npos;
+
+		const void* found = std::memchr(mpData + position, c, mSize - position);
+		return found ? static_cast<const char*>( found ) - mpData : String::npos;
+	}
+
+	///////////////////////////////////////////////////////////
+	/// \brief Copy the characters into a String
+	///
+	/// \return New string
+	///
+	///////////////////////////////////////////////////////////
+	inline String ToString() const
+	{
+		return String(mpData, mSize);
+	}
+
+	inline bool operator==(const StringView& other) const
+	{
+		return mSize == other.mSize && ( mSize == 0 || std::memcmp(mpData, other.mpData, mSize) == 0 );
+	}
+
+	inline bool operator!=(const StringView& other) const
+	{
+		return !( *this == other );
+	}
+
+private:
+	const char* mpData;
+	size_t mSize;
+};
+///////////////////////////////////////////////////////////
+/// \class StringView
+/// \brief Refers to characters owned by someone else
+///
+/// A pointer and a length: cheap to pass around and never
+/// allocates. The characters aren't null-terminated, and
+/// the view is only valid as long as what it points into.
+/// Use ToString() to keep a copy.
+///
+/// \see LineReader
+///
+///////////////////////////////////////////////////////////
+
+inline std::ostream& operator<<(std::ostream& stream, const StringView& view)
+{
+	return stream.write(view.data(), view.size());
+}
+
+// FromString, without copying into a String first
+
+namespace priv
+{
+template<typename T>
+inline T ParseInteger(const StringView& in)
+{
+	const char* c = in.begin();
+	const char* end = in.end();
+
+	while (c != end && ( *c == ' ' || *c == '\t' ))
+		c++;
+
+	bool negative = false;
+	if (c != end && ( *c == '-' || *c == '+' ))
+		negative = ( *c++ == '-' );
+
+	// Accumulate unsigned so overflow wraps instead of being undefined, like atol gives garbage
+	typename std::make_unsigned<T>::type value = 0;
+	while (c != end && *c >= '0' && *c <= '9')
+		value = value * 10 + ( *c++ - '0' );
+
+	return static_cast<T>( negative ? 0 - value : value );
+}
+
+inline Double ParseReal(const StringView& in)
+{
+	char buffer[64]; // strtod needs a terminator
+	size_t size = std::min(in.size(), sizeof(buffer) - 1);
+	std::memcpy(buffer, in.data(), size);
+	buffer[size] = '\0';
+	return std::strtod(buffer, nullptr);
+}
+}
+
+template<typename T>
+T API_EXPORT FromString(const StringView& in);
+
+// Literals would be ambiguous between the String and StringView versions
+template<typename T>
+inline API_EXPORT T FromString(const char* in)
+{
+	return FromString<T>(StringView(in));
+}
+
+template<>
+inline API_EXPORT Int FromString<Int>(const StringView& in)
+{
+	return priv::ParseInteger<Int>(in);
+}
+
+template<>
+inline API_EXPORT Long FromString<Long>(const StringView& in)
+{
+	return priv::ParseInteger<Long>(in);
+}
+
+template<>
+inline API_EXPORT Float FromString<Float>(const StringView& in)
+{
+	return static_cast<Float>( priv::ParseReal(in) );
+}
+
+template<>
+inline API_EXPORT Double FromString<Double>(const StringView& in)
+{
+	return priv::ParseReal(in);
+}
+
+template<>
+inline API_EXPORT bool FromString<bool>(const StringView& in)
+{
+	return in.size() == 4 && string::Lower(in.ToString()) == "true";
+}
+
+} // klib
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <functional> // std::hash
 
 #include <KLib/Config.hpp>
 #include <KLib/String.hpp> // ::ToHexString
@@ -54,7 +55,7 @@ public:
 	{
 		if (mRunning)
 		{
-			KL_WARNING("Attempted to Start() a Thread which is already running");
+			KL_WARNING_RATE(10, "Attempted to Start() a Thread which is already running");
 
 			return false;
 		}
@@ -63,7 +64,7 @@ public:
 			mRunning = true;
 			mThread = std::thread(&Thread::Run, this);
 
-			KL_WARNING("Thread", "Created a new thread (" + ToHexString(mThread.get_id().hash()) + ")");
+			KL_DEBUGLOG("Created a new thread (" + ToHexString(std::hash<std::thread::id>()(mThread.get_id())) + ")");
 
 			return true;
 		}
@@ -96,7 +97,7 @@ public:
 		}
 		else
 		{
-			KL_WARNING("Attempted to Stop() a Thread which isn't running");
+			KL_WARNING_RATE(10, "Attempted to Stop() a Thread which isn't running");
 		}
 	}
 	
@@ -111,7 +112,7 @@ public:
 	///////////////////////////////////////////////////////////
 	inline bool Join()
 	{
-		if (mRunning)
+		if (mThread.joinable())
 		{
 			mThread.join();
 			mDetached = false;
@@ -132,7 +133,7 @@ public:
 	///////////////////////////////////////////////////////////
 	inline bool Detach()
 	{
-		if (mRunning && !mDetached)
+		if (mThread.joinable() && !mDetached)
 		{
 			mThread.detach();
 			mDetached = true;
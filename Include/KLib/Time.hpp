@@ -77,6 +77,15 @@ inline API_EXPORT ULong GetCurrentTime(void)
 	return duration_cast<T>( high_resolution_clock::now().time_since_epoch() ).count();
 }
 
+namespace priv
+{
+inline high_resolution_clock::time_point GetStartTimePoint(void)
+{
+	static const high_resolution_clock::time_point timeStarted = high_resolution_clock::now();
+	return timeStarted;
+}
+}
+
 ///////////////////////////////////////////////////////////////
 /// \brief The time since the game stated, in nanoseconds
 ///
@@ -91,7 +100,7 @@ inline API_EXPORT ULong GetCurrentTime(void)
 template<typename T = nanoseconds>
 inline API_EXPORT ULong GetElapsedTime(void)
 {
-	return duration_cast<T>( high_resolution_clock::now().time_since_epoch() - timeStarted.time_since_epoch() ).count();
+	return duration_cast<T>( high_resolution_clock::now() - priv::GetStartTimePoint() ).count();
 }
 
 ///////////////////////////////////////////////////////////////
@@ -108,7 +117,7 @@ inline API_EXPORT ULong GetElapsedTime(void)
 template<typename T = nanoseconds>
 inline API_EXPORT ULong GetStartTime(void)
 {
-	return duration_cast<T>( timeStarted ).count();
+	return duration_cast<T>( priv::GetStartTimePoint().time_since_epoch() ).count();
 }
 
 template<typename T = milliseconds>
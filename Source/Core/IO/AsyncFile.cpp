@@ -0,0 +1,785 @@
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <cerrno>
+#	include <fcntl.h>
+#	include <sys/stat.h>
+#	include <sys/uio.h>
+#	include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include <KLib/Thread.hpp>
+#include <KLib/CycleClock.hpp>
+#include <KLib/Logging.hpp>
+#include <KLib/AsyncFile.hpp>
+
+#ifdef KL_IO_URING // Set by AsyncFile.hpp
+#	include <linux/io_uring.h>
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#endif
+
+namespace klib
+{
+namespace io
+{
+
+namespace priv
+{
+
+struct IOOperationState
+{
+	IOResult result;
+	IOCallback callback;
+#ifndef _WIN32
+	iovec vector; // io_uring reads and writes through an iovec, which must outlive the submission
+	Long transferred; // io_uring resubmits short transfers, bytes done by the earlier ones
+	IOOperationState* previous; // Requests the kernel holds, failed together if the ring breaks
+	IOOperationState* next;
+#endif
+};
+
+inline ULong GetTimestamp()
+{
+	return time::CycleClock::ToNanoseconds(time::CycleClock::Now());
+}
+
+class IOEngine
+{
+public:
+	IOEngine(IOQueue& queue)
+		: mQueue(queue) {}
+
+	virtual ~IOEngine() {}
+
+	virtual void Submit(IOOperationState** states, UInt count) = 0;
+
+protected:
+	inline void Complete(IOOperationState* state, Long bytes, Int error)
+	{
+		mQueue.Complete(state, bytes, error);
+	}
+
+	IOQueue& mQueue;
+};
+
+///////////////////////////////////////////////////////////
+// Thread pool
+///////////////////////////////////////////////////////////
+
+// Blocking positional IO, retried until everything is transferred or the end of the file
+void PerformBlocking(IOResult& result, Long& bytes, Int& error)
+{
+	bytes = 0;
+	error = 0;
+
+	while (bytes < result.size)
+	{
+		char* buffer = result.buffer + bytes;
+		ULong offset = result.offset + bytes;
+		UInt remaining = result.size - static_cast<UInt>( bytes );
+
+#ifdef _WIN32
+		OVERLAPPED overlapped; // Only used for the offset, the handle isn't opened for overlapped IO
+		std::memset(&overlapped, 0, sizeof(overlapped));
+		overlapped.Offset = static_cast<DWORD>( offset & 0xFFFFFFFF );
+		overlapped.OffsetHigh = static_cast<DWORD>( offset >> 32 );
+
+		DWORD transferred = 0;
+		BOOL success = ( result.operation == IO_READ ) ?
+			ReadFile(result.file->GetHandle(), buffer, remaining, &transferred, &overlapped) :
+			WriteFile(result.file->GetHandle(), buffer, remaining, &transferred, &overlapped);
+
+		if (!success)
+		{
+			if (GetLastError() == ERROR_HANDLE_EOF)
+				break;
+			error = static_cast<Int>( GetLastError() );
+			bytes = -1;
+			return;
+		}
+		Long done = static_cast<Long>( transferred );
+#else
+		ssize_t done = ( result.operation == IO_READ ) ?
+			pread(result.file->GetHandle(), buffer, remaining, static_cast<off_t>( offset )) :
+			pwrite(result.file->GetHandle(), buffer, remaining, static_cast<off_t>( offset ));
+
+		if (done < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			error = errno;
+			bytes = -1;
+			return;
+		}
+#endif
+		if (done == 0)
+			break; // End of file
+
+		bytes += done;
+	}
+}
+
+class ThreadEngine : public IOEngine
+{
+public:
+	ThreadEngine(IOQueue& queue, UInt threads)
+		: IOEngine(queue), mStopping(false)
+	{
+		for (UInt i = 0; i < threads; i++)
+		{
+			mWorkers.push_back(new Worker(*this));
+			mWorkers.back()->Start();
+		}
+	}
+
+	~ThreadEngine()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStopping = true;
+		}
+		mCondition.notify_all();
+
+		for (Worker* worker : mWorkers)
+		{
+			worker->Stop();
+			delete worker;
+		}
+	}
+
+	void Submit(IOOperationState** states, UInt count) override
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			for (UInt i = 0; i < count; i++)
+				mQueue.push_back(states[i]);
+		}
+
+		if (count == 1)
+			mCondition.notify_one();
+		else
+			mCondition.notify_all();
+	}
+
+private:
+	class Worker : public Thread
+	{
+	public:
+		Worker(ThreadEngine& engine)
+			: mEngine(engine) {}
+
+		void* Run() override
+		{
+			while (true)
+			{
+				IOOperationState* state;
+				{
+					std::unique_lock<std::mutex> lock(mEngine.mMutex);
+					mEngine.mCondition.wait(lock, [this] { return !mEngine.mQueue.empty() || mEngine.mStopping; });
+
+					if (mEngine.mQueue.empty())
+						break; // Stopping, IOQueue waited for everything in flight
+
+					state = mEngine.mQueue.front();
+					mEngine.mQueue.pop_front();
+				}
+
+				Long bytes;
+				Int error;
+				PerformBlocking(state->result, bytes, error);
+				mEngine.Complete(state, bytes, error);
+			}
+
+			return nullptr;
+		}
+
+	private:
+		ThreadEngine& mEngine;
+	};
+
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	LinkedList<IOOperationState*> mQueue;
+	bool mStopping;
+	ArrayList<Worker*> mWorkers;
+};
+
+///////////////////////////////////////////////////////////
+// io_uring
+///////////////////////////////////////////////////////////
+
+#ifdef KL_IO_URING
+
+class UringEngine : public IOEngine
+{
+public:
+	UringEngine(IOQueue& queue)
+		: IOEngine(queue), mRing(-1), mpSubmissionRing(MAP_FAILED), mpCompletionRing(MAP_FAILED), mpEntries(MAP_FAILED),
+		mSubmissionRingSize(0), mCompletionRingSize(0), mEntriesSize(0), mFailed(false), mError(0), mpInFlight(nullptr), mReaper(*this)
+	{
+	}
+
+	~UringEngine()
+	{
+		if (mReaper.IsRunning())
+		{
+			// A NOP with no state tells the reaper to stop, IOQueue waited for everything else
+			IOOperationState* stop = nullptr;
+			Submit(&stop, 1);
+		}
+		mReaper.Join(); // Also when it stopped on an error, destroying a joinable thread terminates
+
+		if (mpEntries != MAP_FAILED)
+			munmap(mpEntries, mEntriesSize);
+		if (mpCompletionRing != MAP_FAILED && mpCompletionRing != mpSubmissionRing)
+			munmap(mpCompletionRing, mCompletionRingSize);
+		if (mpSubmissionRing != MAP_FAILED)
+			munmap(mpSubmissionRing, mSubmissionRingSize);
+		if (mRing >= 0)
+			close(mRing);
+	}
+
+	///////////////////////////////////////////////////////////
+	// Fails on kernels before 5.1, or where io_uring is
+	// disabled (kernel.io_uring_disabled, seccomp filters)
+	///////////////////////////////////////////////////////////
+	bool Setup(UInt entries)
+	{
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+
+		mRing = static_cast<int>( syscall(__NR_io_uring_setup, entries, &params) );
+		if (mRing < 0)
+			return false;
+
+		mSubmissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		mCompletionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		mEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+		bool singleMap = ( params.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+		if (singleMap)
+			mSubmissionRingSize = mCompletionRingSize = std::max(mSubmissionRingSize, mCompletionRingSize);
+
+		mpSubmissionRing = mmap(nullptr, mSubmissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_SQ_RING);
+		if (mpSubmissionRing == MAP_FAILED)
+			return false;
+
+		mpCompletionRing = singleMap ? mpSubmissionRing :
+			mmap(nullptr, mCompletionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_CQ_RING);
+		if (mpCompletionRing == MAP_FAILED)
+			return false;
+
+		mpEntries = mmap(nullptr, mEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_SQES);
+		if (mpEntries == MAP_FAILED)
+			return false;
+
+		char* submission = static_cast<char*>( mpSubmissionRing );
+		mpSubmissionHead = reinterpret_cast<unsigned*>( submission + params.sq_off.head );
+		mpSubmissionTail = reinterpret_cast<unsigned*>( submission + params.sq_off.tail );
+		mSubmissionMask = *reinterpret_cast<unsigned*>( submission + params.sq_off.ring_mask );
+		mpSubmissionArray = reinterpret_cast<unsigned*>( submission + params.sq_off.array );
+
+		char* completion = static_cast<char*>( mpCompletionRing );
+		mpCompletionHead = reinterpret_cast<unsigned*>( completion + params.cq_off.head );
+		mpCompletionTail = reinterpret_cast<unsigned*>( completion + params.cq_off.tail );
+		mCompletionMask = *reinterpret_cast<unsigned*>( completion + params.cq_off.ring_mask );
+		mpCompletions = reinterpret_cast<io_uring_cqe*>( completion + params.cq_off.cqes );
+
+		return mReaper.Start();
+	}
+
+	void Submit(IOOperationState** states, UInt count) override
+	{
+		Push(states, count, true);
+	}
+
+private:
+	void Push(IOOperationState** states, UInt count, bool track)
+	{
+		ArrayList<IOOperationState*> failed;
+		Int error;
+		{
+			std::lock_guard<std::mutex> lock(mSubmitMutex);
+
+			if (mFailed)
+			{
+				failed.assign(states, states + count);
+				error = mError;
+			}
+			else
+			{
+				if (track)
+				{
+					std::lock_guard<std::mutex> inFlightLock(mInFlightMutex);
+					for (UInt i = 0; i < count; i++)
+						if (states[i])
+							Track(states[i]);
+				}
+
+				error = Enqueue(states, count, failed);
+			}
+
+			if (!failed.empty() && !mFailed)
+			{
+				std::lock_guard<std::mutex> inFlightLock(mInFlightMutex);
+				for (IOOperationState* state : failed)
+					if (state)
+						Untrack(state);
+			}
+		}
+
+		// Outside the lock, the callbacks may submit again
+		for (IOOperationState* state : failed)
+			if (state)
+				Complete(state, -1, error);
+	}
+
+	// Caller holds mSubmitMutex. Adds the requests the kernel didn't take to failed and returns the error.
+	Int Enqueue(IOOperationState** states, UInt count, ArrayList<IOOperationState*>& failed)
+	{
+		io_uring_sqe* entries = static_cast<io_uring_sqe*>( mpEntries );
+		unsigned tail = *mpSubmissionTail; // Only written by us
+
+		for (UInt i = 0; i < count; i++)
+		{
+			unsigned index = tail & mSubmissionMask;
+			io_uring_sqe& entry = entries[index];
+			std::memset(&entry, 0, sizeof(entry));
+
+			IOOperationState* state = states[i];
+			if (state)
+			{
+				state->vector.iov_base = state->result.buffer + state->transferred;
+				state->vector.iov_len = state->result.size - static_cast<UInt>( state->transferred );
+
+				entry.opcode = ( state->result.operation == IO_READ ) ? IORING_OP_READV : IORING_OP_WRITEV;
+				entry.fd = state->result.file->GetHandle();
+				entry.addr = reinterpret_cast<ULong>( &state->vector );
+				entry.len = 1;
+				entry.off = state->result.offset + state->transferred;
+			}
+			else
+			{
+				entry.opcode = IORING_OP_NOP;
+			}
+			entry.user_data = reinterpret_cast<ULong>( state );
+
+			mpSubmissionArray[index] = index;
+			tail++;
+		}
+
+		// The kernel may read the entries once it sees the new tail
+		__atomic_store_n(mpSubmissionTail, tail, __ATOMIC_RELEASE);
+
+		UInt submitted = 0;
+		while (submitted < count)
+		{
+			int result = static_cast<int>( syscall(__NR_io_uring_enter, mRing, count - submitted, 0, 0, nullptr, 0) );
+			if (result < 0)
+			{
+				if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				// Nothing polls the ring, so the entries the kernel didn't take can be withdrawn
+				Int error = errno;
+				unsigned head = __atomic_load_n(mpSubmissionHead, __ATOMIC_ACQUIRE);
+				__atomic_store_n(mpSubmissionTail, head, __ATOMIC_RELEASE);
+
+				UInt left = static_cast<UInt>( tail - head );
+				failed.insert(failed.end(), states + count - left, states + count);
+
+				KL_ERROR("io_uring_enter failed, " + ToString(left) + " requests were cancelled");
+				return error;
+			}
+			submitted += static_cast<UInt>( result );
+		}
+
+		return 0;
+	}
+
+	// Caller holds mInFlightMutex
+	void Track(IOOperationState* state)
+	{
+		state->previous = nullptr;
+		state->next = mpInFlight;
+		if (mpInFlight)
+			mpInFlight->previous = state;
+		mpInFlight = state;
+	}
+
+	void Untrack(IOOperationState* state)
+	{
+		if (state->previous)
+			state->previous->next = state->next;
+		else
+			mpInFlight = state->next;
+
+		if (state->next)
+			state->next->previous = state->previous;
+	}
+
+	void Finish(IOOperationState* state, Long bytes, Int error)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mInFlightMutex);
+			Untrack(state);
+		}
+		Complete(state, bytes, error);
+	}
+
+	// The ring can't be waited on anymore, fail what the kernel holds and everything submitted later
+	void Abandon(Int error)
+	{
+		IOOperationState* state;
+		{
+			std::lock_guard<std::mutex> lock(mSubmitMutex);
+			std::lock_guard<std::mutex> inFlightLock(mInFlightMutex);
+
+			mFailed = true;
+			mError = error;
+			state = mpInFlight;
+			mpInFlight = nullptr;
+		}
+
+		while (state)
+		{
+			IOOperationState* next = state->next;
+			Complete(state, -1, error);
+			state = next;
+		}
+	}
+
+	class Reaper : public Thread
+	{
+	public:
+		Reaper(UringEngine& engine)
+			: mEngine(engine) {}
+
+		inline bool IsRunning() const
+		{
+			return mRunning;
+		}
+
+		void* Run() override
+		{
+			bool stopping = false;
+
+			while (!stopping)
+			{
+				int result = static_cast<int>( syscall(__NR_io_uring_enter, mEngine.mRing, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) );
+				if (result < 0 && errno != EINTR)
+				{
+					KL_ERROR("io_uring_enter failed while waiting for completions");
+					mEngine.Abandon(errno);
+					break;
+				}
+
+				unsigned head = *mEngine.mpCompletionHead; // Only written by us
+				unsigned tail = __atomic_load_n(mEngine.mpCompletionTail, __ATOMIC_ACQUIRE);
+
+				while (head != tail)
+				{
+					const io_uring_cqe& completion = mEngine.mpCompletions[head & mEngine.mCompletionMask];
+					IOOperationState* state = reinterpret_cast<IOOperationState*>( completion.user_data );
+					Int code = completion.res;
+					head++;
+
+					// Hand the slot back before the callback, which may take a while
+					__atomic_store_n(mEngine.mpCompletionHead, head, __ATOMIC_RELEASE);
+
+					if (!state)
+					{
+						stopping = true;
+						continue;
+					}
+
+					if (code == -EINTR)
+					{
+						mEngine.Push(&state, 1, false);
+						continue;
+					}
+
+					if (code < 0)
+					{
+						mEngine.Finish(state, -1, -code);
+						continue;
+					}
+
+					// A short transfer isn't the end like in PerformBlocking, only 0 bytes is
+					state->transferred += code;
+					if (code > 0 && state->transferred < state->result.size)
+						mEngine.Push(&state, 1, false);
+					else
+						mEngine.Finish(state, state->transferred, 0);
+				}
+			}
+
+			mRunning = false;
+			return nullptr;
+		}
+
+	private:
+		UringEngine& mEngine;
+	};
+
+	int mRing;
+	void* mpSubmissionRing;
+	void* mpCompletionRing;
+	void* mpEntries;
+	size_t mSubmissionRingSize;
+	size_t mCompletionRingSize;
+	size_t mEntriesSize;
+
+	std::mutex mSubmitMutex;
+	unsigned* mpSubmissionHead;
+	unsigned* mpSubmissionTail;
+	unsigned mSubmissionMask;
+	unsigned* mpSubmissionArray;
+
+	unsigned* mpCompletionHead;
+	unsigned* mpCompletionTail;
+	unsigned mCompletionMask;
+	io_uring_cqe* mpCompletions;
+
+	bool mFailed; // Guarded by mSubmitMutex
+	Int mError;
+
+	std::mutex mInFlightMutex; // Taken after mSubmitMutex when both are needed
+	IOOperationState* mpInFlight;
+
+	Reaper mReaper;
+};
+
+#endif // KL_IO_URING
+
+} // priv
+
+AsyncFile::AsyncFile()
+	: mOpen(false), mMode(0)
+{
+#ifdef _WIN32
+	mHandle = INVALID_HANDLE_VALUE;
+#else
+	mHandle = -1;
+#endif
+}
+
+AsyncFile::AsyncFile(const String& path, FileMode mode)
+	: AsyncFile()
+{
+	Open(path, mode);
+}
+
+AsyncFile::~AsyncFile(void)
+{
+	Close();
+}
+
+bool AsyncFile::Open(const String& path, FileMode mode)
+{
+	Close();
+
+	bool read = ( mode & FileModes::Read ) > 0;
+	bool write = ( mode & priv::WritableModes ) > 0;
+	bool truncate = ( mode & FileModes::Overwrite ) > 0;
+
+#ifdef _WIN32
+	DWORD access = ( read || !write ? GENERIC_READ : 0 ) | ( write ? GENERIC_WRITE : 0 );
+	DWORD disposition = truncate ? CREATE_ALWAYS : ( write ? OPEN_ALWAYS : OPEN_EXISTING );
+
+	mHandle = CreateFileA(path.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL);
+	mOpen = ( mHandle != INVALID_HANDLE_VALUE );
+#else
+	int flags = O_CLOEXEC;
+	if (write)
+		flags |= ( read ? O_RDWR : O_WRONLY ) | O_CREAT | ( truncate ? O_TRUNC : 0 );
+	else
+		flags |= O_RDONLY;
+
+	mHandle = open(path.c_str(), flags, 0644);
+	mOpen = ( mHandle >= 0 );
+#endif
+
+	mMode = mode;
+	mPath = path;
+
+	if (!mOpen)
+		KL_WARNING("Failed to open file '" + path + "'");
+
+	return mOpen;
+}
+
+void AsyncFile::Close()
+{
+	if (!mOpen)
+		return;
+
+#ifdef _WIN32
+	CloseHandle(mHandle);
+	mHandle = INVALID_HANDLE_VALUE;
+#else
+	close(mHandle);
+	mHandle = -1;
+#endif
+	mOpen = false;
+}
+
+ULong AsyncFile::GetSize() const
+{
+	if (!mOpen)
+		return 0;
+
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	return GetFileSizeEx(mHandle, &size) ? static_cast<ULong>( size.QuadPart ) : 0;
+#else
+	struct stat info;
+	return ( fstat(mHandle, &info) == 0 ) ? static_cast<ULong>( info.st_size ) : 0;
+#endif
+}
+
+IOQueue::IOQueue(UInt queueDepth, UInt threads)
+	: mQueueDepth(std::min<UInt>(std::max<UInt>(queueDepth, 1), 4096)), mBackend(IO_BACKEND_THREADS), mPending(0), mCompleting(0), mpEngine(nullptr)
+{
+	// Completion timestamps
+	if (!time::CycleClock::IsCalibrated())
+		time::CycleClock::Calibrate();
+
+#ifdef KL_IO_URING
+	priv::UringEngine* engine = new priv::UringEngine(*this);
+	if (engine->Setup(mQueueDepth))
+	{
+		mpEngine = engine;
+		mBackend = IO_BACKEND_URING;
+		return;
+	}
+
+	KL_INFO("io_uring is unavailable, falling back to IO worker threads");
+	SAFE_DELETE(engine);
+#endif
+
+	if (threads == 0)
+		threads = std::max<UInt>(std::thread::hardware_concurrency(), 1);
+
+	mpEngine = new priv::ThreadEngine(*this, std::min(threads, mQueueDepth));
+}
+
+IOQueue::~IOQueue(void)
+{
+	Wait();
+	SAFE_DELETE(mpEngine);
+}
+
+void IOQueue::Submit(const IORequest* requests, UInt count)
+{
+	ArrayList<priv::IOOperationState*> states;
+
+	UInt done = 0;
+	while (done < count)
+	{
+		UInt slots;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this] { return mPending < mQueueDepth; });
+
+			slots = std::min(count - done, mQueueDepth - mPending);
+			mPending += slots;
+		}
+
+		states.resize(slots);
+		ULong now = priv::GetTimestamp();
+
+		for (UInt i = 0; i < slots; i++)
+		{
+			const IORequest& request = requests[done + i];
+
+			priv::IOOperationState* state = new priv::IOOperationState();
+			state->result.operation = request.operation;
+			state->result.file = request.file;
+			state->result.offset = request.offset;
+			state->result.buffer = request.buffer;
+			state->result.size = request.size;
+			state->result.bytes = 0;
+			state->result.error = 0;
+			state->result.submitted = now;
+			state->result.completed = 0;
+			state->callback = request.callback;
+
+			states[i] = state;
+		}
+
+		mpEngine->Submit(states.data(), slots);
+		done += slots;
+	}
+}
+
+std::future<IOResult> IOQueue::Read(AsyncFile& file, ULong offset, char* buffer, UInt size)
+{
+	std::shared_ptr<std::promise<IOResult>> promise = std::make_shared<std::promise<IOResult>>();
+	std::future<IOResult> future = promise->get_future();
+
+	Submit(IORequest(IO_READ, file, offset, buffer, size, [promise](const IOResult& result) { promise->set_value(result); }));
+	return future;
+}
+
+std::future<IOResult> IOQueue::Write(AsyncFile& file, ULong offset, const char* data, UInt size)
+{
+	std::shared_ptr<std::promise<IOResult>> promise = std::make_shared<std::promise<IOResult>>();
+	std::future<IOResult> future = promise->get_future();
+
+	// Writes never modify the buffer, IORequest only has one pointer for both directions
+	Submit(IORequest(IO_WRITE, file, offset, const_cast<char*>( data ), size, [promise](const IOResult& result) { promise->set_value(result); }));
+	return future;
+}
+
+void IOQueue::Wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mCondition.wait(lock, [this] { return mPending == 0 && mCompleting == 0; });
+}
+
+UInt IOQueue::GetPending() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mPending;
+}
+
+void IOQueue::Complete(priv::IOOperationState* state, Long bytes, Int error)
+{
+	time::CycleClock::Update();
+
+	state->result.bytes = bytes;
+	state->result.error = error;
+	state->result.completed = priv::GetTimestamp();
+
+	// Free the slot first, a callback submitting to a full queue would otherwise wait for itself
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mPending--;
+		mCompleting++;
+	}
+	mCondition.notify_all();
+
+	if (state->callback)
+		state->callback(state->result);
+	SAFE_DELETE(state);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mCompleting--;
+	}
+	mCondition.notify_all();
+}
+
+} // io
+} // klib
@@ -0,0 +1,78 @@
+
+#include <KLib/BufferedWriter.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+BufferedWriter::BufferedWriter(FileBase& file, UInt bufferSize, NewlinePolicy newline)
+	: mFile(file), mBuffer(bufferSize > 0 ? bufferSize : 1), mUsed(0), mFlushed(0), mHealthy(true)
+{
+#ifdef _WIN32
+	bool crlf = ( newline != NEWLINE_LF );
+#else
+	bool crlf = ( newline == NEWLINE_CRLF );
+#endif
+
+	mNewlineSize = 0;
+	if (crlf)
+		mNewline[mNewlineSize++] = '\r';
+	mNewline[mNewlineSize++] = '\n';
+
+	KL_ASSERT(( file.GetMode() & priv::WritableModes ) > 0);
+}
+
+BufferedWriter::~BufferedWriter(void)
+{
+	Flush();
+}
+
+bool BufferedWriter::Flush()
+{
+	WriteBuffer();
+	mFile.GetStream().flush();
+
+	mHealthy = mHealthy && mFile.IsHealthy();
+	return mHealthy;
+}
+
+bool BufferedWriter::WriteThrough(const char* data, size_t size)
+{
+	// Top up the buffer first, so the file sees full buffer-sized writes
+	size_t space = mBuffer.size() - mUsed;
+	std::memcpy(mBuffer.data() + mUsed, data, space);
+	mUsed += space;
+	data += space;
+	size -= space;
+
+	WriteBuffer();
+
+	if (size >= mBuffer.size())
+	{
+		mFile.GetStream().write(data, static_cast<std::streamsize>( size ));
+		mHealthy = mHealthy && mFile.IsHealthy();
+		mFlushed += size;
+		return mHealthy;
+	}
+
+	std::memcpy(mBuffer.data(), data, size);
+	mUsed = size;
+	return mHealthy;
+}
+
+bool BufferedWriter::WriteBuffer()
+{
+	if (mUsed == 0)
+		return mHealthy;
+
+	mFile.GetStream().write(mBuffer.data(), static_cast<std::streamsize>( mUsed ));
+	mHealthy = mHealthy && mFile.IsHealthy();
+	mFlushed += mUsed;
+	mUsed = 0;
+
+	return mHealthy;
+}
+
+} // io
+} // klib
@@ -0,0 +1,436 @@
+
+#include <algorithm>
+#include <cstring>
+
+#include <KLib/Compression.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+namespace priv
+{
+
+const UInt g_minMatch = 4;
+const UInt g_lastLiterals = 5; // The format requires the last bytes to be literals
+const UInt g_matchSearchLimit = 12; // No match may start in the last bytes
+const UInt g_maxOffset = 65535;
+const UInt g_hashBits = 12;
+
+const char g_frameMagic[4] = { 'K', 'L', 'Z', '1' };
+const UInt g_storedFlag = 0x80000000u;
+
+inline UInt Read32(const char* data)
+{
+	UInt value;
+	std::memcpy(&value, data, sizeof(UInt));
+	return value;
+}
+
+inline UInt Hash(UInt sequence)
+{
+	return ( sequence * 2654435761u ) >> ( 32 - g_hashBits );
+}
+
+// Writes the 255, 255, ..., rest tail of a length which didn't fit in its nibble
+inline bool WriteLength(char*& out, const char* end, UInt length)
+{
+	while (length >= 255)
+	{
+		if (out >= end)
+			return false;
+		*out++ = static_cast<char>( 255 );
+		length -= 255;
+	}
+
+	if (out >= end)
+		return false;
+	*out++ = static_cast<char>( length );
+	return true;
+}
+
+inline bool ReadLength(const Byte*& in, const Byte* end, UInt& length)
+{
+	Byte next;
+	do
+	{
+		if (in >= end)
+			return false;
+		next = *in++;
+		length += next;
+	}
+	while (next == 255);
+
+	return true;
+}
+
+bool WriteSequence(char*& out, const char* end, const char* literals, UInt literalCount, UInt offset, UInt matchLength)
+{
+	if (out >= end)
+		return false;
+
+	char* token = out++;
+	UInt matchCode = ( matchLength >= g_minMatch ) ? matchLength - g_minMatch : 0;
+	*token = static_cast<char>( ( ( literalCount < 15 ? literalCount : 15 ) << 4 ) | ( matchCode < 15 ? matchCode : 15 ) );
+
+	if (literalCount >= 15 && !WriteLength(out, end, literalCount - 15))
+		return false;
+
+	if (end - out < (ptrdiff_t)literalCount)
+		return false;
+	std::memcpy(out, literals, literalCount);
+	out += literalCount;
+
+	// The last sequence is only literals
+	if (matchLength == 0)
+		return true;
+
+	if (end - out < 2)
+		return false;
+	*out++ = static_cast<char>( offset & 0xFF );
+	*out++ = static_cast<char>( offset >> 8 );
+
+	return matchCode < 15 || WriteLength(out, end, matchCode - 15);
+}
+
+} // priv
+
+UInt CompressBlock(const char* source, UInt size, char* destination, UInt capacity)
+{
+	char* out = destination;
+	const char* end = destination + capacity;
+
+	UInt anchor = 0;
+
+	if (size > priv::g_matchSearchLimit)
+	{
+		UInt table[1 << priv::g_hashBits]; // Position + 1 of the last sequence with each hash, 0 if none
+		std::memset(table, 0, sizeof(table));
+
+		UInt limit = size - priv::g_matchSearchLimit;
+		UInt matchEnd = size - priv::g_lastLiterals;
+		UInt position = 0;
+		UInt misses = 0;
+
+		while (position < limit)
+		{
+			UInt sequence = priv::Read32(source + position);
+			UInt& slot = table[priv::Hash(sequence)];
+			UInt candidate = slot;
+			slot = position + 1;
+
+			if (candidate == 0 || position - ( candidate - 1 ) > priv::g_maxOffset ||
+				priv::Read32(source + candidate - 1) != sequence)
+			{
+				// Skip faster through data which doesn't compress
+				position += 1 + ( misses++ >> 6 );
+				continue;
+			}
+
+			UInt match = candidate - 1;
+			misses = 0;
+
+			while (position > anchor && match > 0 && source[position - 1] == source[match - 1])
+			{
+				position--;
+				match--;
+			}
+
+			UInt length = priv::g_minMatch;
+			while (position + length < matchEnd && source[position + length] == source[match + length])
+				length++;
+
+			if (!priv::WriteSequence(out, end, source + anchor, position - anchor, position - match, length))
+				return 0;
+
+			position += length;
+			anchor = position;
+		}
+	}
+
+	if (!priv::WriteSequence(out, end, source + anchor, size - anchor, 0, 0))
+		return 0;
+
+	return static_cast<UInt>( out - destination );
+}
+
+Int DecompressBlock(const char* source, UInt size, char* destination, UInt capacity)
+{
+	const Byte* in = reinterpret_cast<const Byte*>( source );
+	const Byte* inEnd = in + size;
+	UInt written = 0;
+
+	while (in < inEnd)
+	{
+		Byte token = *in++;
+
+		UInt literalCount = token >> 4;
+		if (literalCount == 15 && !priv::ReadLength(in, inEnd, literalCount))
+			return -1;
+
+		if ((size_t)( inEnd - in ) < literalCount || capacity - written < literalCount)
+			return -1;
+		std::memcpy(destination + written, in, literalCount);
+		in += literalCount;
+		written += literalCount;
+
+		if (in == inEnd)
+			break; // Last sequence
+
+		if (inEnd - in < 2)
+			return -1;
+		UInt offset = in[0] | ( in[1] << 8 );
+		in += 2;
+
+		UInt length = token & 15;
+		if (length == 15 && !priv::ReadLength(in, inEnd, length))
+			return -1;
+		length += priv::g_minMatch;
+
+		if (offset == 0 || offset > written || capacity - written < length)
+			return -1;
+
+		// Matches may overlap what they produce, e.g. offset 1 repeats a byte
+		char* out = destination + written;
+		const char* match = out - offset;
+		if (offset >= length)
+			std::memcpy(out, match, length);
+		else
+			for (UInt i = 0; i < length; i++)
+				out[i] = match[i];
+
+		written += length;
+	}
+
+	return static_cast<Int>( written );
+}
+
+CompressedWriter::CompressedWriter()
+	: mpFile(nullptr), mBlockSize(0), mFailed(false)
+{
+}
+
+CompressedWriter::~CompressedWriter(void)
+{
+	Close();
+}
+
+bool CompressedWriter::Open(const String& path, UInt blockSize)
+{
+	Close();
+
+	mpFile = std::fopen(path.c_str(), "wb");
+	if (!mpFile)
+		return false;
+
+	mBlockSize = blockSize > 0 ? blockSize : 1;
+	mBlock.clear();
+	mBlock.reserve(mBlockSize);
+	mCompressed.resize(GetCompressBound(mBlockSize));
+
+	mFailed = std::fwrite(priv::g_frameMagic, sizeof(priv::g_frameMagic), 1, mpFile) != 1 ||
+		std::fwrite(&mBlockSize, sizeof(UInt), 1, mpFile) != 1;
+
+	return !mFailed;
+}
+
+bool CompressedWriter::Write(const char* data, size_t size)
+{
+	if (!mpFile)
+		return false;
+
+	while (size > 0)
+	{
+		size_t count = std::min<size_t>(size, mBlockSize - mBlock.size());
+		mBlock.insert(mBlock.end(), data, data + count);
+		data += count;
+		size -= count;
+
+		if (mBlock.size() == mBlockSize && !WriteBlock())
+			return false;
+	}
+
+	return !mFailed;
+}
+
+bool CompressedWriter::Close()
+{
+	if (!mpFile)
+		return true;
+
+	if (!mBlock.empty())
+		WriteBlock();
+
+	UInt end = 0;
+	mFailed = std::fwrite(&end, sizeof(UInt), 1, mpFile) != 1 || mFailed;
+	mFailed = std::fclose(mpFile) != 0 || mFailed;
+	mpFile = nullptr;
+
+	return !mFailed;
+}
+
+bool CompressedWriter::WriteBlock()
+{
+	UInt size = static_cast<UInt>( mBlock.size() );
+	UInt compressed = CompressBlock(mBlock.data(), size, mCompressed.data(), static_cast<UInt>( mCompressed.size() ));
+
+	// Data which doesn't shrink is stored as it is
+	bool stored = ( compressed == 0 || compressed >= size );
+	UInt header = stored ? ( size | priv::g_storedFlag ) : compressed;
+	const char* payload = stored ? mBlock.data() : mCompressed.data();
+	UInt payloadSize = stored ? size : compressed;
+
+	if (std::fwrite(&header, sizeof(UInt), 1, mpFile) != 1 ||
+		std::fwrite(payload, 1, payloadSize, mpFile) != payloadSize)
+		mFailed = true;
+
+	mBlock.clear();
+	return !mFailed;
+}
+
+CompressedReader::CompressedReader()
+	: mpFile(nullptr), mPosition(0), mSize(0), mEnded(false), mCorrupt(false)
+{
+}
+
+CompressedReader::~CompressedReader(void)
+{
+	Close();
+}
+
+bool CompressedReader::Open(const String& path)
+{
+	Close();
+
+	mpFile = std::fopen(path.c_str(), "rb");
+	if (!mpFile)
+		return false;
+
+	char magic[sizeof(priv::g_frameMagic)];
+	UInt blockSize = 0;
+	if (std::fread(magic, sizeof(magic), 1, mpFile) != 1 ||
+		std::memcmp(magic, priv::g_frameMagic, sizeof(magic)) != 0 ||
+		std::fread(&blockSize, sizeof(UInt), 1, mpFile) != 1 ||
+		blockSize == 0 || blockSize >= priv::g_storedFlag)
+	{
+		Close();
+		return false;
+	}
+
+	mBlock.resize(blockSize);
+	mCompressed.resize(GetCompressBound(blockSize));
+	mPosition = 0;
+	mSize = 0;
+	mEnded = false;
+	mCorrupt = false;
+
+	return true;
+}
+
+void CompressedReader::Close()
+{
+	if (mpFile)
+		std::fclose(mpFile);
+	mpFile = nullptr;
+}
+
+size_t CompressedReader::Read(char* data, size_t size)
+{
+	size_t read = 0;
+
+	while (read < size)
+	{
+		if (mPosition == mSize && !ReadBlock())
+			break;
+
+		size_t count = std::min(size - read, mSize - mPosition);
+		std::memcpy(data + read, mBlock.data() + mPosition, count);
+		mPosition += count;
+		read += count;
+	}
+
+	return read;
+}
+
+bool CompressedReader::ReadLine(String& line)
+{
+	line.clear();
+
+	while (true)
+	{
+		if (mPosition == mSize && !ReadBlock())
+			return !line.empty();
+
+		const char* start = mBlock.data() + mPosition;
+		const char* newline = static_cast<const char*>( std::memchr(start, '\n', mSize - mPosition) );
+
+		if (newline)
+		{
+			line.append(start, newline - start);
+			mPosition += ( newline - start ) + 1;
+			return true;
+		}
+
+		// The line carries on in the next block
+		line.append(start, mSize - mPosition);
+		mPosition = mSize;
+	}
+}
+
+bool CompressedReader::ReadBlock()
+{
+	if (!mpFile || mEnded)
+		return false;
+
+	UInt header = 0;
+	if (std::fread(&header, sizeof(UInt), 1, mpFile) != 1)
+	{
+		mCorrupt = true; // Cut short before the end marker
+		mEnded = true;
+		return false;
+	}
+
+	if (header == 0)
+	{
+		mEnded = true;
+		return false;
+	}
+
+	UInt size = header & ~priv::g_storedFlag;
+	bool stored = ( header & priv::g_storedFlag ) != 0;
+
+	if (size > ( stored ? mBlock.size() : mCompressed.size() ))
+	{
+		mCorrupt = true;
+		mEnded = true;
+		return false;
+	}
+
+	char* target = stored ? mBlock.data() : mCompressed.data();
+	if (std::fread(target, 1, size, mpFile) != size)
+	{
+		mCorrupt = true;
+		mEnded = true;
+		return false;
+	}
+
+	if (!stored)
+	{
+		Int decompressed = DecompressBlock(mCompressed.data(), size, mBlock.data(), static_cast<UInt>( mBlock.size() ));
+		if (decompressed < 0)
+		{
+			mCorrupt = true;
+			mEnded = true;
+			return false;
+		}
+		size = static_cast<UInt>( decompressed );
+	}
+
+	mPosition = 0;
+	mSize = size;
+	return true;
+}
+
+} // io
+} // klib
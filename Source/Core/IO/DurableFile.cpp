@@ -0,0 +1,170 @@
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+#include <cstdio> // rename, remove
+
+#include <KLib/DurableFile.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+namespace priv
+{
+// A rename is only durable once the directory holding it is synced
+bool SyncDirectoryOf(const String& path)
+{
+#ifdef _WIN32
+	return true; // MOVEFILE_WRITE_THROUGH already waited for it
+#else
+	size_t slash = path.find_last_of('/');
+	String directory = ( slash == String::npos ) ? "." : ( slash == 0 ? "/" : path.substr(0, slash) );
+
+	int descriptor = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0)
+		return false;
+
+	bool result = fsync(descriptor) == 0;
+	close(descriptor);
+	return result;
+#endif
+}
+}
+
+GroupCommitWriter::GroupCommitWriter(BinaryFile& file)
+	: mFile(file), mWritten(0), mDurable(0), mSyncs(0), mSyncing(false), mFailed(false)
+{
+}
+
+ULong GroupCommitWriter::Write(const void* data, size_t size)
+{
+	IOSegment segment(data, size);
+	return Write(&segment, 1);
+}
+
+ULong GroupCommitWriter::Write(const IOSegment* segments, UInt count)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (mFailed || !mFile.WriteV(segments, count))
+	{
+		mFailed = true;
+		return 0;
+	}
+
+	return ++mWritten;
+}
+
+bool GroupCommitWriter::WaitDurable(ULong ticket)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	while (ticket > mDurable && !mFailed)
+	{
+		if (mSyncing)
+		{
+			mCondition.wait(lock);
+			continue;
+		}
+
+		// Lead a sync for every record written so far
+		mSyncing = true;
+		ULong target = mWritten;
+
+		mFile.Flush();
+		bool flushed = mFile.IsHealthy();
+		NativeFileHandle descriptor = mFile.GetNativeHandle();
+
+		// Others keep writing while the disk works, their records go in the next sync
+		lock.unlock();
+		bool synced = flushed && priv::SyncPath(mFile.GetPath(), descriptor);
+		lock.lock();
+
+		mSyncing = false;
+		mSyncs++;
+		if (synced)
+			mDurable = target;
+		else
+			mFailed = true;
+
+		mCondition.notify_all();
+	}
+
+	return ticket > 0 && ticket <= mDurable;
+}
+
+ULong GroupCommitWriter::GetSyncCount()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mSyncs;
+}
+
+bool GroupCommitWriter::IsHealthy()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return !mFailed;
+}
+
+AtomicFile::~AtomicFile()
+{
+	if (IsOpen())
+		Discard();
+}
+
+bool AtomicFile::Open(String path, FileMode mode)
+{
+	if (IsOpen())
+		Discard();
+
+	mTargetPath = path;
+	return BinaryFile::Open(path + ".tmp", FileModes::Overwrite | ( mode & FileModes::Read ));
+}
+
+bool AtomicFile::Commit()
+{
+	if (!IsOpen())
+		return false;
+
+	bool synced = Sync();
+	Close();
+
+	if (!synced)
+	{
+		std::remove(mPath.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	bool renamed = MoveFileExA(mPath.c_str(), mTargetPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool renamed = std::rename(mPath.c_str(), mTargetPath.c_str()) == 0; // Atomic, even over an existing file
+#endif
+
+	if (!renamed)
+	{
+		KL_WARNING("Failed to replace file '" + mTargetPath + "'");
+		std::remove(mPath.c_str());
+		return false;
+	}
+
+	return priv::SyncDirectoryOf(mTargetPath);
+}
+
+void AtomicFile::Discard()
+{
+	if (!IsOpen())
+		return;
+
+	Close();
+	std::remove(mPath.c_str());
+}
+
+} // io
+} // klib
@@ -0,0 +1,587 @@
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <cerrno>
+#	include <climits> // IOV_MAX
+#	include <fcntl.h>
+#	include <sys/uio.h>
+#	include <unistd.h>
+#endif
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#	include <sys/sendfile.h>
+#	include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include <KLib/File.hpp>
+#include <KLib/FileSystem.hpp>
+
+#if defined(__GLIBCXX__) && !defined(_WIN32)
+#	define KL_FILEBUF_DESCRIPTOR
+#endif
+
+namespace klib
+{
+namespace io
+{
+
+namespace priv
+{
+
+#ifdef KL_FILEBUF_DESCRIPTOR
+// libstdc++ keeps the open file in a protected member of basic_filebuf. A member
+// pointer named through a subclass reaches it without pretending the filebuf is one.
+struct FilebufAccess : std::filebuf
+{
+	static std::__basic_file<char> std::filebuf::* GetFileMember()
+	{
+		return &FilebufAccess::_M_file;
+	}
+};
+#endif
+
+#ifdef POSIX_FADV_NORMAL
+inline int TranslateFileAdvice(AccessHint hint)
+{
+	switch (hint)
+	{
+		case AccessHints::Sequential: return POSIX_FADV_SEQUENTIAL;
+		case AccessHints::Random: return POSIX_FADV_RANDOM;
+		case AccessHints::WillNeed: return POSIX_FADV_WILLNEED;
+		case AccessHints::DontNeed: return POSIX_FADV_DONTNEED;
+		case AccessHints::Normal: break;
+	}
+	return POSIX_FADV_NORMAL;
+}
+#endif
+
+// Runs on a throwaway thread, so the caller never waits for the IO to be queued
+void PrefetchRange(String path, ULong offset, ULong length)
+{
+#ifdef _WIN32
+	// No page cache hint for plain files, reading the range is what warms it
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	const DWORD chunk = 1024 * 1024;
+	ArrayList<char> buffer(chunk);
+
+	while (length > 0)
+	{
+		OVERLAPPED overlapped; // Only used for the offset
+		std::memset(&overlapped, 0, sizeof(overlapped));
+		overlapped.Offset = static_cast<DWORD>( offset & 0xFFFFFFFF );
+		overlapped.OffsetHigh = static_cast<DWORD>( offset >> 32 );
+
+		DWORD read = 0;
+		DWORD wanted = static_cast<DWORD>( length < chunk ? length : chunk );
+		if (!ReadFile(file, buffer.data(), wanted, &read, &overlapped) || read == 0)
+			break;
+
+		offset += read;
+		length -= read;
+	}
+
+	CloseHandle(file);
+#elif defined(POSIX_FADV_WILLNEED)
+	int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0)
+		return;
+
+	// Linux caps each WillNeed at the device's read-ahead size, so queue the range a slice at a time
+	const ULong slice = 2 * 1024 * 1024;
+	for (ULong done = 0; done < length; done += slice)
+		posix_fadvise(descriptor, static_cast<off_t>( offset + done ), static_cast<off_t>( std::min(slice, length - done) ), POSIX_FADV_WILLNEED);
+
+	close(descriptor);
+#endif
+}
+
+// Wait for the file's data to reach the disk; metadata only if the size changed
+bool SyncPath(const String& path, NativeFileHandle descriptor)
+{
+#ifdef _WIN32
+	// The stream's HANDLE isn't reachable, but flushing any handle to the file flushes all of it
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool result = FlushFileBuffers(file) != 0;
+	CloseHandle(file);
+	return result;
+#else
+	// The page cache belongs to the file, so syncing another descriptor to it works too
+	bool borrowed = ( descriptor == InvalidNativeHandle );
+	if (borrowed)
+	{
+		descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (descriptor < 0)
+			return false;
+	}
+
+#	if defined(__APPLE__)
+	bool result = fcntl(descriptor, F_FULLFSYNC) == 0; // fsync() on macOS doesn't flush the drive's cache
+#	elif defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+	bool result = fdatasync(descriptor) == 0;
+#	else
+	bool result = fsync(descriptor) == 0;
+#	endif
+
+	if (borrowed)
+		close(descriptor);
+
+	return result;
+#endif
+}
+
+// Below this a vectored call costs more than copying into the stream's buffer
+const ULong g_vectoredMinimum = 64 * 1024;
+
+#if defined(KL_FILEBUF_DESCRIPTOR) && defined(IOV_MAX)
+#	define KL_VECTORED_IO
+
+// pwritev/preadv until every segment is done, the kernel may stop partway through any of them
+ULong TransferVector(int descriptor, ULong offset, const IOSegment* segments, UInt count, bool write)
+{
+	ArrayList<iovec> vectors(count);
+	for (UInt i = 0; i < count; i++)
+	{
+		vectors[i].iov_base = segments[i].data;
+		vectors[i].iov_len = segments[i].size;
+	}
+
+	ULong transferred = 0;
+	iovec* next = vectors.data();
+	iovec* end = next + count;
+
+	while (next != end)
+	{
+		if (next->iov_len == 0)
+		{
+			next++;
+			continue;
+		}
+
+		int batch = static_cast<int>( std::min<ptrdiff_t>(end - next, IOV_MAX) );
+		ssize_t done = write ?
+			pwritev(descriptor, next, batch, static_cast<off_t>( offset + transferred )) :
+			preadv(descriptor, next, batch, static_cast<off_t>( offset + transferred ));
+
+		if (done < 0 && errno == EINTR)
+			continue;
+		if (done <= 0)
+			break; // Error, or the end of the file
+
+		transferred += done;
+
+		// Skip what was transferred, the last segment touched may be partly done
+		while (next != end && static_cast<size_t>( done ) >= next->iov_len)
+		{
+			done -= next->iov_len;
+			next++;
+		}
+		if (next != end)
+		{
+			next->iov_base = static_cast<char*>( next->iov_base ) + done;
+			next->iov_len -= done;
+		}
+	}
+
+	return transferred;
+}
+#endif
+
+#ifdef KL_FILEBUF_DESCRIPTOR
+// Copy between descriptors at the given offsets, with the fastest method the kernel accepts
+ULong CopyRange(int in, ULong inOffset, int out, ULong outOffset, ULong length)
+{
+	ULong copied = 0;
+	const ULong slice = 1 << 30; // Keep each call well inside ssize_t on 32-bit systems
+
+#ifdef SYS_copy_file_range
+	// Stays inside the kernel, and may share the blocks on reflink filesystems or copy on an NFS server.
+	// Refused across filesystems before Linux 5.3, and for files opened with O_APPEND.
+	while (copied < length)
+	{
+		loff_t from = static_cast<loff_t>( inOffset + copied );
+		loff_t to = static_cast<loff_t>( outOffset + copied );
+		long done = syscall(SYS_copy_file_range, in, &from, out, &to, static_cast<size_t>( std::min(length - copied, slice) ), 0u);
+
+		if (done < 0 && errno == EINTR)
+			continue;
+		if (done == 0)
+			return copied; // End of the source
+		if (done < 0)
+			break;
+
+		copied += done;
+	}
+#endif
+
+#ifdef __linux__
+	// Also kernel-side, but writes at the output's own file position
+	if (copied < length && lseek(out, static_cast<off_t>( outOffset + copied ), SEEK_SET) >= 0)
+	{
+		while (copied < length)
+		{
+			off_t from = static_cast<off_t>( inOffset + copied );
+			ssize_t done = sendfile(out, in, &from, static_cast<size_t>( std::min(length - copied, slice) ));
+
+			if (done < 0 && errno == EINTR)
+				continue;
+			if (done == 0)
+				return copied;
+			if (done < 0)
+				break;
+
+			copied += done;
+		}
+	}
+#endif
+
+	// Anything else, e.g. macOS or an O_APPEND output; a large buffer keeps the syscalls few
+	if (copied < length)
+	{
+		const size_t bufferSize = 1024 * 1024;
+		ArrayList<char> buffer(static_cast<size_t>( std::min<ULong>(length - copied, bufferSize) ));
+
+		while (copied < length)
+		{
+			ssize_t read = pread(in, buffer.data(), static_cast<size_t>( std::min<ULong>(length - copied, buffer.size()) ), static_cast<off_t>( inOffset + copied ));
+			if (read < 0 && errno == EINTR)
+				continue;
+			if (read <= 0)
+				break;
+
+			ssize_t written = 0;
+			while (written < read)
+			{
+				ssize_t done = pwrite(out, buffer.data() + written, static_cast<size_t>( read - written ), static_cast<off_t>( outOffset + copied + written ));
+				if (done < 0 && errno == EINTR)
+					continue;
+				if (done <= 0)
+					return copied + written;
+				written += done;
+			}
+
+			copied += read;
+		}
+	}
+
+	return copied;
+}
+#endif
+
+} // priv
+
+ULong Transfer(FileBase& source, FileBase& destination, ULong length)
+{
+	KL_ASSERT((source.GetMode() & FileModes::Read) > 0);
+	KL_ASSERT((destination.GetMode() & priv::WritableModes) > 0);
+
+	if (!source.IsOpen() || !destination.IsOpen() || !source.IsHealthy() || !destination.IsHealthy())
+		return 0;
+
+	ULong position = source.Tell();
+	ULong size = source.GetSize();
+	length = ( position < size ) ? std::min(length, size - position) : 0;
+
+	std::fstream& in = source.GetStream();
+	std::fstream& out = destination.GetStream();
+
+#ifdef KL_FILEBUF_DESCRIPTOR
+	NativeFileHandle inDescriptor = source.GetNativeHandle();
+	NativeFileHandle outDescriptor = destination.GetNativeHandle();
+
+	if (inDescriptor != InvalidNativeHandle && outDescriptor != InvalidNativeHandle)
+	{
+		// The file has to hold everything written through the streams first
+		if (( source.GetMode() & priv::WritableModes ) > 0)
+			in.flush();
+		out.flush();
+
+		bool append = ( destination.GetMode() & FileModes::Append ) > 0;
+		ULong target = append ? destination.GetSize() : destination.Tell();
+
+		ULong copied = priv::CopyRange(inDescriptor, position, outDescriptor, target, length);
+
+		// Move both streams past the data; seeking also drops what they had buffered
+		in.seekg(static_cast<std::streamoff>( position + copied ));
+		if (append)
+			out.seekp(0, std::ios::end);
+		else
+			out.seekp(static_cast<std::streamoff>( target + copied ));
+
+		if (copied != length)
+			out.setstate(std::ios::badbit);
+
+		return copied;
+	}
+#endif
+
+	const size_t bufferSize = 1024 * 1024;
+	ArrayList<char> buffer(static_cast<size_t>( std::min<ULong>(length, bufferSize) ));
+	ULong copied = 0;
+
+	while (copied < length)
+	{
+		in.read(buffer.data(), static_cast<std::streamsize>( std::min<ULong>(length - copied, buffer.size()) ));
+		std::streamsize read = in.gcount();
+		if (read <= 0)
+			break;
+
+		out.write(buffer.data(), read);
+		if (!out)
+			break;
+
+		copied += read;
+	}
+
+	return copied;
+}
+
+NativeFileHandle FileBase::GetNativeHandle()
+{
+#ifdef KL_FILEBUF_DESCRIPTOR
+	if (mOpen)
+		return ( mStream.rdbuf()->*priv::FilebufAccess::GetFileMember() ).fd();
+#endif
+	return InvalidNativeHandle;
+}
+
+void FileBase::UpdateSize()
+{
+	NativeFileHandle handle = GetNativeHandle();
+
+	// Asks the open file, the path may have been renamed or replaced since
+	if (handle != InvalidNativeHandle)
+	{
+#ifdef _WIN32
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(handle, &size))
+		{
+			mSize = static_cast<ULong>( size.QuadPart );
+			return;
+		}
+#else
+		struct stat info; // 64-bit with _FILE_OFFSET_BITS=64, see premake5.lua
+		if (fstat(handle, &info) == 0)
+		{
+			mSize = static_cast<ULong>( info.st_size );
+			return;
+		}
+#endif
+	}
+
+	// No handle to ask, measure through the stream instead
+	std::streamoff position = mStream.tellg();
+	if (position < 0)
+	{
+		mSize = 0;
+		return;
+	}
+
+	mStream.seekg(0, std::ios::end);
+	std::streamoff end = mStream.tellg();
+	mStream.seekg(position);
+
+	mSize = ( end > 0 ) ? static_cast<ULong>( end ) : 0;
+}
+
+bool FileBase::Sync()
+{
+	KL_ASSERT((mMode & priv::WritableModes) > 0);
+
+	if (!mOpen)
+		return false;
+
+	mStream.flush();
+	if (!IsHealthy())
+		return false;
+
+	return priv::SyncPath(mPath, GetNativeHandle());
+}
+
+bool FileBase::Advise(AccessHint hint, ULong offset, ULong length)
+{
+	if (!mOpen)
+		return false;
+
+	if (hint == AccessHints::WillNeed)
+		return Prefetch(offset, length);
+
+#if defined(POSIX_FADV_NORMAL) && !defined(_WIN32)
+	int descriptor = GetNativeHandle();
+	bool borrowed = ( descriptor == InvalidNativeHandle );
+
+	if (borrowed)
+	{
+		// Read-ahead settings belong to the open file, another descriptor wouldn't change ours
+		if (hint != AccessHints::DontNeed)
+			return false;
+
+		// The page cache is shared though
+		descriptor = open(mPath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (descriptor < 0)
+			return false;
+	}
+
+	bool result = posix_fadvise(descriptor, static_cast<off_t>( offset ), static_cast<off_t>( length ), priv::TranslateFileAdvice(hint)) == 0;
+
+	if (borrowed)
+		close(descriptor);
+
+	return result;
+#else
+	return false; // No posix_fadvise, e.g. Windows and macOS
+#endif
+}
+
+bool FileBase::Prefetch(ULong offset, ULong length)
+{
+	if (!mOpen)
+		return false;
+
+#if !defined(_WIN32) && !defined(POSIX_FADV_WILLNEED)
+	return false;
+#else
+	if (length == 0)
+	{
+		ULong size = GetSize();
+		length = ( size > offset ) ? size - offset : 0;
+	}
+
+	std::thread(priv::PrefetchRange, mPath, offset, length).detach();
+	return true;
+#endif
+}
+
+bool BinaryFile::WriteV(const IOSegment* segments, UInt count)
+{
+	KL_ASSERT((mMode & priv::WritableModes) > 0);
+
+	ULong expected = 0;
+	for (UInt i = 0; i < count; i++)
+		expected += segments[i].size;
+
+	// Small records are cheaper copied into the stream's buffer, which writes many of them at once
+	NativeFileHandle descriptor = GetNativeHandle();
+	if (descriptor == InvalidNativeHandle || expected < priv::g_vectoredMinimum || !IsHealthy())
+	{
+		for (UInt i = 0; i < count; i++)
+			mStream.write(segments[i].data, static_cast<std::streamsize>( segments[i].size ));
+		return IsHealthy();
+	}
+
+#ifdef KL_VECTORED_IO
+	// Hand the stream's buffered data to the file first, then write at the stream's position
+	mStream.flush();
+	bool append = ( mMode & FileModes::Append ) > 0;
+	ULong position = append ? 0 : Tell();
+
+	ULong written = priv::TransferVector(descriptor, position, segments, count, true); // Linux appends with O_APPEND whatever the offset
+
+	// Move the stream past the data; seeking also resets its buffers
+	if (append)
+		mStream.seekp(0, std::ios::end);
+	else
+		mStream.seekp(static_cast<std::streamoff>( position + written ));
+
+	if (written != expected)
+		mStream.setstate(std::ios::badbit);
+
+	return IsHealthy();
+#else
+	return false;
+#endif
+}
+
+bool BinaryFile::ReadV(const IOSegment* segments, UInt count)
+{
+	KL_ASSERT((mMode & io::FileModes::Read) > 0);
+
+	ULong expected = 0;
+	for (UInt i = 0; i < count; i++)
+		expected += segments[i].size;
+
+	NativeFileHandle descriptor = GetNativeHandle();
+	if (descriptor == InvalidNativeHandle || expected < priv::g_vectoredMinimum || !IsHealthy())
+	{
+		for (UInt i = 0; i < count; i++)
+			mStream.read(segments[i].data, static_cast<std::streamsize>( segments[i].size ));
+		return IsHealthy();
+	}
+
+#ifdef KL_VECTORED_IO
+	// The stream may have read ahead, its position is where the caller is
+	if (( mMode & priv::WritableModes ) > 0)
+		mStream.flush();
+	ULong position = Tell();
+
+	ULong read = priv::TransferVector(descriptor, position, segments, count, false);
+	mStream.seekg(static_cast<std::streamoff>( position + read ));
+
+	if (read != expected)
+		mStream.setstate(std::ios::eofbit | std::ios::failbit); // Like read() at the end of the file
+
+	return IsHealthy();
+#else
+	return false;
+#endif
+}
+
+} // io
+
+namespace filesystem
+{
+
+Long File::GetSize(const String& path)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0)
+		return -1;
+#else
+	struct stat info; // 64-bit with _FILE_OFFSET_BITS=64, see premake5.lua
+	if (stat(path.c_str(), &info) != 0)
+		return -1;
+#endif
+	return static_cast<Long>( info.st_size );
+}
+
+bool File::Copy(const String& source, const String& destination, ULong offset, ULong length)
+{
+#ifdef _WIN32
+	if (offset == 0 && length == ~0ULL)
+		return CopyFileA(source.c_str(), destination.c_str(), FALSE) != 0;
+#endif
+
+	klib::io::BinaryFile in(source, klib::io::FileModes::Read);
+	if (!in.IsOpen())
+		return false;
+
+	klib::io::BinaryFile out(destination, klib::io::FileModes::Overwrite);
+	if (!out.IsOpen())
+		return false;
+
+	ULong size = in.GetSize();
+	offset = std::min(offset, size);
+	length = std::min(length, size - offset);
+
+	in.Seek(offset);
+	return klib::io::Transfer(in, out, length) == length && out.IsHealthy();
+}
+
+} // filesystem
+} // klib
@@ -0,0 +1,477 @@
+#if defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+#	include <intrin.h>
+#	include <nmmintrin.h>
+#	define KL_CRC32C_SSE42
+#elif ( defined(__GNUC__) || defined(__clang__) ) && ( defined(__x86_64__) || defined(__i386__) )
+#	include <cpuid.h>
+#	include <nmmintrin.h>
+#	define KL_CRC32C_SSE42
+#elif defined(__ARM_FEATURE_CRC32)
+#	include <arm_acle.h>
+#	define KL_CRC32C_ARM
+#endif
+
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <KLib/File.hpp>
+#include <KLib/Hash.hpp>
+
+namespace klib
+{
+
+namespace priv
+{
+
+inline ULong RotateLeft(ULong value, int bits)
+{
+	return ( value << bits ) | ( value >> ( 64 - bits ) );
+}
+
+// Little-endian loads, for any alignment
+inline ULong Read64(const char* data)
+{
+	ULong value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+inline UInt Read32(const char* data)
+{
+	UInt value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+// CRC-32C
+
+const UInt Crc32CPolynomial = 0x82F63B78; // Castagnoli, bit-reversed
+
+struct Crc32CTables
+{
+	UInt table[8][256];
+
+	Crc32CTables()
+	{
+		for (UInt i = 0; i < 256; i++)
+		{
+			UInt crc = i;
+			for (int bit = 0; bit < 8; bit++)
+				crc = ( crc >> 1 ) ^ ( ( crc & 1 ) ? Crc32CPolynomial : 0 );
+			table[0][i] = crc;
+		}
+
+		// table[n] advances a byte's CRC past n more zero bytes, so 8 bytes are looked up at once
+		for (UInt i = 0; i < 256; i++)
+			for (int n = 1; n < 8; n++)
+				table[n][i] = ( table[n - 1][i] >> 8 ) ^ table[0][table[n - 1][i] & 0xFF];
+	}
+};
+
+UInt UpdateCrc32CSoftware(UInt crc, const char* data, size_t size)
+{
+	static const Crc32CTables tables; // Built on first use
+	const UInt (*table)[256] = tables.table;
+
+	// Slicing-by-8
+	while (size >= 8)
+	{
+		ULong word = Read64(data) ^ crc;
+		crc = table[7][word & 0xFF] ^ table[6][( word >> 8 ) & 0xFF] ^
+			table[5][( word >> 16 ) & 0xFF] ^ table[4][( word >> 24 ) & 0xFF] ^
+			table[3][( word >> 32 ) & 0xFF] ^ table[2][( word >> 40 ) & 0xFF] ^
+			table[1][( word >> 48 ) & 0xFF] ^ table[0][word >> 56];
+		data += 8;
+		size -= 8;
+	}
+
+	while (size-- > 0)
+		crc = ( crc >> 8 ) ^ table[0][( crc ^ static_cast<Byte>( *data++ ) ) & 0xFF];
+
+	return crc;
+}
+
+#ifdef KL_CRC32C_SSE42
+#	if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2"))) // Only called once the CPU is known to have it
+#	endif
+UInt UpdateCrc32CHardware(UInt crc, const char* data, size_t size)
+{
+	while (size > 0 && ( reinterpret_cast<size_t>( data ) & 7 ) != 0)
+	{
+		crc = _mm_crc32_u8(crc, static_cast<Byte>( *data++ ));
+		size--;
+	}
+
+#	if defined(__x86_64__) || defined(_M_X64)
+	ULong crc64 = crc;
+	for (; size >= 8; data += 8, size -= 8)
+		crc64 = _mm_crc32_u64(crc64, Read64(data));
+	crc = static_cast<UInt>( crc64 );
+#	endif
+
+	for (; size >= 4; data += 4, size -= 4)
+		crc = _mm_crc32_u32(crc, Read32(data));
+
+	while (size-- > 0)
+		crc = _mm_crc32_u8(crc, static_cast<Byte>( *data++ ));
+
+	return crc;
+}
+
+bool HasCrc32CInstruction()
+{
+#	ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return ( info[2] & ( 1 << 20 ) ) != 0;
+#	else
+	unsigned int eax, ebx, ecx, edx;
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && ( ecx & bit_SSE4_2 ) != 0;
+#	endif
+}
+#elif defined(KL_CRC32C_ARM)
+UInt UpdateCrc32CHardware(UInt crc, const char* data, size_t size)
+{
+	for (; size >= 8; data += 8, size -= 8)
+		crc = __crc32cd(crc, Read64(data));
+
+	while (size-- > 0)
+		crc = __crc32cb(crc, static_cast<Byte>( *data++ ));
+
+	return crc;
+}
+
+bool HasCrc32CInstruction()
+{
+	return true; // Compiled for a CPU with the CRC extension
+}
+#endif
+
+typedef UInt (*Crc32CFunction)(UInt crc, const char* data, size_t size);
+
+Crc32CFunction ChooseCrc32C()
+{
+#if defined(KL_CRC32C_SSE42) || defined(KL_CRC32C_ARM)
+	if (HasCrc32CInstruction())
+		return UpdateCrc32CHardware;
+#endif
+	return UpdateCrc32CSoftware;
+}
+
+const Crc32CFunction g_updateCrc32C = ChooseCrc32C();
+
+// XXH64
+
+const ULong XXPrime1 = 11400714785074694791ULL;
+const ULong XXPrime2 = 14029467366897019727ULL;
+const ULong XXPrime3 = 1609587929392839161ULL;
+const ULong XXPrime4 = 9650029242287828579ULL;
+const ULong XXPrime5 = 2870177450012600261ULL;
+
+inline ULong XXRound(ULong lane, ULong input)
+{
+	lane += input * XXPrime2;
+	lane = RotateLeft(lane, 31);
+	return lane * XXPrime1;
+}
+
+inline ULong XXMergeRound(ULong hash, ULong lane)
+{
+	hash ^= XXRound(0, lane);
+	return hash * XXPrime1 + XXPrime4;
+}
+
+// MurmurHash3 x64 128
+
+const ULong MurmurC1 = 0x87c37b91114253d5ULL;
+const ULong MurmurC2 = 0x4cf5ad432745937fULL;
+
+inline ULong MurmurMix(ULong k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+inline void MurmurBlock(ULong& h1, ULong& h2, const char* data)
+{
+	ULong k1 = Read64(data);
+	ULong k2 = Read64(data + 8);
+
+	k1 *= MurmurC1; k1 = RotateLeft(k1, 31); k1 *= MurmurC2; h1 ^= k1;
+	h1 = RotateLeft(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+	k2 *= MurmurC2; k2 = RotateLeft(k2, 33); k2 *= MurmurC1; h2 ^= k2;
+	h2 = RotateLeft(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+}
+
+} // priv
+
+void Crc32C::Update(const void* data, size_t size)
+{
+	mState = priv::g_updateCrc32C(mState, static_cast<const char*>( data ), size);
+}
+
+bool Crc32C::IsHardwareAccelerated()
+{
+	return priv::g_updateCrc32C != priv::UpdateCrc32CSoftware;
+}
+
+void XXHash64::Reset(ULong seed)
+{
+	mSeed = seed;
+	mLanes[0] = seed + priv::XXPrime1 + priv::XXPrime2;
+	mLanes[1] = seed + priv::XXPrime2;
+	mLanes[2] = seed;
+	mLanes[3] = seed - priv::XXPrime1;
+	mTotal = 0;
+	mBuffered = 0;
+}
+
+void XXHash64::Update(const void* data, size_t size)
+{
+	const char* input = static_cast<const char*>( data );
+	mTotal += size;
+
+	// Finish a stripe left over from the last call
+	if (mBuffered > 0)
+	{
+		size_t needed = std::min<size_t>(sizeof(mBuffer) - mBuffered, size);
+		std::memcpy(mBuffer + mBuffered, input, needed);
+		mBuffered += static_cast<UInt>( needed );
+		input += needed;
+		size -= needed;
+
+		if (mBuffered < sizeof(mBuffer))
+			return;
+
+		for (int lane = 0; lane < 4; lane++)
+			mLanes[lane] = priv::XXRound(mLanes[lane], priv::Read64(mBuffer + lane * 8));
+		mBuffered = 0;
+	}
+
+	// Locals, so the four lanes stay in registers
+	ULong v1 = mLanes[0], v2 = mLanes[1], v3 = mLanes[2], v4 = mLanes[3];
+	for (; size >= 32; input += 32, size -= 32)
+	{
+		v1 = priv::XXRound(v1, priv::Read64(input));
+		v2 = priv::XXRound(v2, priv::Read64(input + 8));
+		v3 = priv::XXRound(v3, priv::Read64(input + 16));
+		v4 = priv::XXRound(v4, priv::Read64(input + 24));
+	}
+	mLanes[0] = v1; mLanes[1] = v2; mLanes[2] = v3; mLanes[3] = v4;
+
+	std::memcpy(mBuffer, input, size);
+	mBuffered = static_cast<UInt>( size );
+}
+
+ULong XXHash64::Get() const
+{
+	ULong hash;
+
+	if (mTotal >= 32)
+	{
+		hash = priv::RotateLeft(mLanes[0], 1) + priv::RotateLeft(mLanes[1], 7) +
+			priv::RotateLeft(mLanes[2], 12) + priv::RotateLeft(mLanes[3], 18);
+		for (int lane = 0; lane < 4; lane++)
+			hash = priv::XXMergeRound(hash, mLanes[lane]);
+	}
+	else
+	{
+		hash = mSeed + priv::XXPrime5;
+	}
+
+	hash += mTotal;
+
+	const char* tail = mBuffer;
+	UInt left = mBuffered;
+
+	for (; left >= 8; tail += 8, left -= 8)
+	{
+		hash ^= priv::XXRound(0, priv::Read64(tail));
+		hash = priv::RotateLeft(hash, 27) * priv::XXPrime1 + priv::XXPrime4;
+	}
+
+	if (left >= 4)
+	{
+		hash ^= static_cast<ULong>( priv::Read32(tail) ) * priv::XXPrime1;
+		hash = priv::RotateLeft(hash, 23) * priv::XXPrime2 + priv::XXPrime3;
+		tail += 4;
+		left -= 4;
+	}
+
+	for (; left > 0; tail++, left--)
+	{
+		hash ^= static_cast<Byte>( *tail ) * priv::XXPrime5;
+		hash = priv::RotateLeft(hash, 11) * priv::XXPrime1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= priv::XXPrime2;
+	hash ^= hash >> 29;
+	hash *= priv::XXPrime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+void MurmurHash128::Reset(UInt seed)
+{
+	mH1 = seed;
+	mH2 = seed;
+	mTotal = 0;
+	mBuffered = 0;
+}
+
+void MurmurHash128::Update(const void* data, size_t size)
+{
+	const char* input = static_cast<const char*>( data );
+	mTotal += size;
+
+	if (mBuffered > 0)
+	{
+		size_t needed = std::min<size_t>(sizeof(mBuffer) - mBuffered, size);
+		std::memcpy(mBuffer + mBuffered, input, needed);
+		mBuffered += static_cast<UInt>( needed );
+		input += needed;
+		size -= needed;
+
+		if (mBuffered < sizeof(mBuffer))
+			return;
+
+		priv::MurmurBlock(mH1, mH2, mBuffer);
+		mBuffered = 0;
+	}
+
+	ULong h1 = mH1, h2 = mH2;
+	for (; size >= 16; input += 16, size -= 16)
+		priv::MurmurBlock(h1, h2, input);
+	mH1 = h1; mH2 = h2;
+
+	std::memcpy(mBuffer, input, size);
+	mBuffered = static_cast<UInt>( size );
+}
+
+Hash128 MurmurHash128::Get() const
+{
+	ULong h1 = mH1, h2 = mH2;
+	ULong k1 = 0, k2 = 0;
+	const Byte* tail = reinterpret_cast<const Byte*>( mBuffer );
+
+	for (UInt i = mBuffered; i > 8; i--)
+		k2 ^= static_cast<ULong>( tail[i - 1] ) << ( ( i - 9 ) * 8 );
+	for (UInt i = std::min<UInt>(mBuffered, 8); i > 0; i--)
+		k1 ^= static_cast<ULong>( tail[i - 1] ) << ( ( i - 1 ) * 8 );
+
+	if (mBuffered > 8)
+	{
+		k2 *= priv::MurmurC2; k2 = priv::RotateLeft(k2, 33); k2 *= priv::MurmurC1; h2 ^= k2;
+	}
+	if (mBuffered > 0)
+	{
+		k1 *= priv::MurmurC1; k1 = priv::RotateLeft(k1, 31); k1 *= priv::MurmurC2; h1 ^= k1;
+	}
+
+	h1 ^= mTotal;
+	h2 ^= mTotal;
+	h1 += h2;
+	h2 += h1;
+	h1 = priv::MurmurMix(h1);
+	h2 = priv::MurmurMix(h2);
+	h1 += h2;
+	h2 += h1;
+
+	Hash128 hash = { h1, h2 };
+	return hash;
+}
+
+namespace io
+{
+
+bool ReadOverlapped(const String& path, const std::function<void(const char*, size_t)>& consume)
+{
+	BinaryFile file(path, FileModes::Read);
+	if (!file.IsOpen())
+		return false;
+
+	file.Advise(AccessHints::Sequential);
+
+	// The reader fills blocks ahead while the caller works through the full ones
+	const UInt blockCount = 4;
+	const size_t blockSize = 1024 * 1024;
+
+	ArrayList<char> blocks[blockCount];
+	size_t sizes[blockCount];
+	for (UInt i = 0; i < blockCount; i++)
+		blocks[i].resize(blockSize);
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	ULong filled = 0; // Blocks read so far
+	ULong consumed = 0; // Blocks handed to consume()
+	bool finished = false;
+	bool failed = false;
+
+	std::thread reader([&]()
+	{
+		std::fstream& stream = file.GetStream();
+
+		while (true)
+		{
+			ULong block;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [&]() { return filled - consumed < blockCount; });
+				block = filled;
+			}
+
+			// The slot is free, nobody else touches it until it is handed over
+			UInt slot = static_cast<UInt>( block % blockCount );
+			stream.read(blocks[slot].data(), static_cast<std::streamsize>( blockSize ));
+			sizes[slot] = static_cast<size_t>( stream.gcount() );
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (sizes[slot] > 0)
+				filled++;
+
+			if (!stream)
+			{
+				finished = true;
+				failed = !stream.eof(); // Reaching the end isn't an error
+			}
+
+			condition.notify_all();
+			if (finished)
+				return;
+		}
+	});
+
+	while (true)
+	{
+		UInt slot;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [&]() { return consumed < filled || finished; });
+			if (consumed == filled)
+				break; // Finished, and everything read was consumed
+			slot = static_cast<UInt>( consumed % blockCount );
+		}
+
+		consume(blocks[slot].data(), sizes[slot]);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		consumed++;
+		condition.notify_all();
+	}
+
+	reader.join();
+	return !failed;
+}
+
+} // io
+} // klib
@@ -0,0 +1,96 @@
+
+#include <cstring>
+
+#include <KLib/LineReader.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+LineReader::LineReader(TextFile& file, UInt chunkSize, ULong length)
+	: mFile(file), mBuffer(chunkSize > 0 ? chunkSize : 1), mStart(0), mEnd(0), mEndOfFile(false), mRemaining(length), mLineNumber(0)
+{
+}
+
+bool LineReader::Next(StringView& line)
+{
+	size_t searched = mStart; // Bytes before this are known not to be a newline
+
+	while (true)
+	{
+		const char* newline = static_cast<const char*>( std::memchr(mBuffer.data() + searched, '\n', mEnd - searched) );
+
+		size_t lineEnd;
+		if (newline)
+		{
+			lineEnd = newline - mBuffer.data();
+		}
+		else if (!mEndOfFile)
+		{
+			searched = mEnd - mStart; // Fill() moves the unread bytes to the front
+			Fill();
+			continue;
+		}
+		else if (mStart < mEnd)
+		{
+			lineEnd = mEnd; // Last line has no newline
+		}
+		else
+		{
+			return false;
+		}
+
+		size_t lineStart = mStart;
+		mStart = ( lineEnd < mEnd ) ? lineEnd + 1 : lineEnd;
+
+		if (lineEnd > lineStart && mBuffer[lineEnd - 1] == '\r')
+			lineEnd--;
+
+		line = StringView(mBuffer.data() + lineStart, lineEnd - lineStart);
+		mLineNumber++;
+		return true;
+	}
+}
+
+bool LineReader::Next(String& line)
+{
+	StringView view;
+	if (!Next(view))
+		return false;
+
+	line.assign(view.data(), view.size());
+	return true;
+}
+
+bool LineReader::Fill()
+{
+	// Keep the partial line, it continues in the next chunk
+	size_t remaining = mEnd - mStart;
+	if (mStart > 0)
+		std::memmove(mBuffer.data(), mBuffer.data() + mStart, remaining);
+	mStart = 0;
+	mEnd = remaining;
+
+	if (mEnd == mBuffer.size())
+		mBuffer.resize(mBuffer.size() * 2); // A line longer than the buffer
+
+	size_t space = mBuffer.size() - mEnd;
+	if (space > mRemaining)
+		space = static_cast<size_t>( mRemaining );
+
+	std::fstream& stream = mFile.GetStream();
+	stream.read(mBuffer.data() + mEnd, static_cast<std::streamsize>( space ));
+
+	size_t read = static_cast<size_t>( stream.gcount() );
+	mEnd += read;
+	mRemaining -= read;
+
+	if (read == 0 || !stream || mRemaining == 0)
+		mEndOfFile = true;
+
+	return read > 0;
+}
+
+} // io
+} // klib
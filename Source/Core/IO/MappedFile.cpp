@@ -0,0 +1,221 @@
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#include <KLib/Logging.hpp>
+#include <KLib/MappedFile.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+namespace priv
+{
+
+struct MappedFileHandle
+{
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int file;
+#endif
+};
+
+#ifndef _WIN32
+inline int TranslateAccessHint(AccessHint hint)
+{
+	switch (hint)
+	{
+		case AccessHints::Sequential: return MADV_SEQUENTIAL;
+		case AccessHints::Random: return MADV_RANDOM;
+		case AccessHints::WillNeed: return MADV_WILLNEED;
+		case AccessHints::DontNeed: return MADV_DONTNEED;
+		case AccessHints::Normal: break;
+	}
+	return MADV_NORMAL;
+}
+#endif
+
+} // priv
+
+MappedFile::MappedFile()
+	: mOpen(false), mMode(MapModes::ReadOnly), mpData(nullptr), mSize(0), mpHandle(nullptr)
+{
+}
+
+MappedFile::MappedFile(const String& path, MapMode mode)
+	: mOpen(false), mMode(MapModes::ReadOnly), mpData(nullptr), mSize(0), mpHandle(nullptr)
+{
+	Open(path, mode);
+}
+
+MappedFile::~MappedFile(void)
+{
+	Close();
+}
+
+bool MappedFile::Open(const String& path, MapMode mode, ULong size)
+{
+	Close();
+
+	mpHandle = new priv::MappedFileHandle();
+	mMode = mode;
+	mPath = path;
+
+	bool shared = ( mode == MapModes::Shared );
+
+#ifdef _WIN32
+	mpHandle->mapping = NULL;
+	mpHandle->file = CreateFileA(path.c_str(), shared ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+		FILE_SHARE_READ | ( shared ? 0 : FILE_SHARE_WRITE ), NULL, shared ? OPEN_ALWAYS : OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (mpHandle->file == INVALID_HANDLE_VALUE)
+	{
+		KL_WARNING("Failed to open file '" + path + "' for mapping");
+		Close();
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(mpHandle->file, &fileSize);
+	mSize = (ULong)fileSize.QuadPart;
+	if (shared && size > mSize)
+		mSize = size; // Mapping past the end grows the file
+
+	if (mSize > 0)
+	{
+		DWORD protect = shared ? PAGE_READWRITE : ( mode == MapModes::CopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY );
+		DWORD access = shared ? FILE_MAP_WRITE : ( mode == MapModes::CopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ );
+
+		mpHandle->mapping = CreateFileMappingA(mpHandle->file, NULL, protect, (DWORD)( mSize >> 32 ), (DWORD)( mSize & 0xFFFFFFFF ), NULL);
+		if (mpHandle->mapping != NULL)
+			mpData = static_cast<char*>( MapViewOfFile(mpHandle->mapping, access, 0, 0, (SIZE_T)mSize) );
+	}
+#else
+	mpHandle->file = open(path.c_str(), shared ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (mpHandle->file < 0)
+	{
+		KL_WARNING("Failed to open file '" + path + "' for mapping");
+		Close();
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(mpHandle->file, &info) != 0)
+	{
+		Close();
+		return false;
+	}
+	mSize = (ULong)info.st_size;
+
+	if (shared && size > mSize)
+	{
+		if (ftruncate(mpHandle->file, (off_t)size) != 0)
+		{
+			KL_WARNING("Failed to grow file '" + path + "' for mapping");
+			Close();
+			return false;
+		}
+		mSize = size;
+	}
+
+	if (mSize > 0)
+	{
+		int protect = ( mode == MapModes::ReadOnly ) ? PROT_READ : PROT_READ | PROT_WRITE;
+		int flags = shared ? MAP_SHARED : MAP_PRIVATE;
+
+		void* data = mmap(nullptr, (size_t)mSize, protect, flags, mpHandle->file, 0);
+		mpData = ( data == MAP_FAILED ) ? nullptr : static_cast<char*>( data );
+	}
+#endif
+
+	if (mSize > 0 && !mpData)
+	{
+		KL_WARNING("Failed to map file '" + path + "'");
+		Close();
+		return false;
+	}
+
+	mOpen = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!mpHandle)
+		return;
+
+#ifdef _WIN32
+	if (mpData)
+		UnmapViewOfFile(mpData);
+	if (mpHandle->mapping != NULL)
+		CloseHandle(mpHandle->mapping);
+	if (mpHandle->file != INVALID_HANDLE_VALUE)
+		CloseHandle(mpHandle->file);
+#else
+	if (mpData)
+		munmap(mpData, (size_t)mSize);
+	if (mpHandle->file >= 0)
+		close(mpHandle->file);
+#endif
+
+	SAFE_DELETE(mpHandle);
+	mpData = nullptr;
+	mSize = 0;
+	mOpen = false;
+}
+
+bool MappedFile::Advise(AccessHint hint, ULong offset, ULong length)
+{
+	if (!mpData || offset >= mSize)
+		return false;
+
+	if (length == 0 || length > mSize - offset)
+		length = mSize - offset;
+
+#ifdef _WIN32
+#	if _WIN32_WINNT >= 0x0602
+	if (hint == AccessHints::WillNeed)
+	{
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = mpData + offset;
+		range.NumberOfBytes = (SIZE_T)length;
+		return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != FALSE;
+	}
+#	endif
+	return true;
+#else
+	// madvise wants a page aligned start
+	static const ULong pageSize = (ULong)sysconf(_SC_PAGESIZE);
+	ULong aligned = offset - offset % pageSize;
+
+	return madvise(mpData + aligned, (size_t)( length + offset - aligned ), priv::TranslateAccessHint(hint)) == 0;
+#endif
+}
+
+bool MappedFile::Flush(bool wait)
+{
+	if (!mpData || mMode != MapModes::Shared)
+		return true;
+
+#ifdef _WIN32
+	if (!FlushViewOfFile(mpData, 0))
+		return false;
+	return !wait || FlushFileBuffers(mpHandle->file);
+#else
+	return msync(mpData, (size_t)mSize, wait ? MS_SYNC : MS_ASYNC) == 0;
+#endif
+}
+
+} // io
+} // klib
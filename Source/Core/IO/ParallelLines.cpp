@@ -0,0 +1,73 @@
+
+#include <cstring>
+
+#include <KLib/ParallelLines.hpp>
+
+namespace klib
+{
+namespace io
+{
+
+ArrayList<FileRange> SplitAtLines(const String& path, UInt parts)
+{
+	ArrayList<FileRange> ranges;
+
+	BinaryFile file;
+	if (!file.Open(path, FileModes::Read))
+		return ranges;
+
+	ULong size = file.GetSize();
+	if (size == 0)
+		return ranges;
+
+	if (parts == 0)
+		parts = 1;
+
+	char buffer[4096];
+	ULong start = 0;
+
+	for (UInt part = 1; part <= parts && start < size; part++)
+	{
+		ULong cut = ( part == parts ) ? size : size / parts * part;
+
+		if (cut <= start)
+			continue; // The last range ran past this cut
+
+		// Move the cut to just after the next newline
+		file.GetStream().clear();
+		file.Seek(cut - 1);
+		while (cut < size)
+		{
+			file.Read(buffer, sizeof(buffer));
+			size_t read = static_cast<size_t>( file.GetStream().gcount() );
+			if (read == 0)
+			{
+				cut = size;
+				break;
+			}
+
+			const char* newline = static_cast<const char*>( std::memchr(buffer, '\n', read) );
+			if (newline)
+			{
+				cut += newline - buffer; // cut - 1 + position + 1
+				break;
+			}
+			cut += read;
+		}
+
+		if (cut > size)
+			cut = size;
+
+		FileRange range;
+		range.offset = start;
+		range.size = cut - start;
+		ranges.push_back(range);
+
+		start = cut;
+	}
+
+	return ranges;
+}
+
+} // io
+} // klib
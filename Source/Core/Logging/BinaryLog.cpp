@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include <KLib/BinaryLog.hpp>
+#include <KLib/File.hpp>
+
+namespace klib
+{
+
+logging::BinaryLogger DefaultBinaryLogger;
+
+namespace logging
+{
+
+namespace priv
+{
+const char BinaryLogMagic[4] = { 'K', 'L', 'B', 'L' };
+
+template<typename T>
+inline void Append(ArrayList<char>& out, const T& value)
+{
+	const char* bytes = reinterpret_cast<const char*>( &value );
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+inline void AppendString(ArrayList<char>& out, const String& value)
+{
+	Append(out, static_cast<UInt>( value.size() ));
+	out.insert(out.end(), value.begin(), value.end());
+}
+
+// Bounds-checked reads out of a chunk
+template<typename T>
+inline bool Extract(const ArrayList<char>& in, size_t& position, T& value)
+{
+	if (position + sizeof(T) > in.size())
+		return false;
+
+	std::memcpy(&value, &in[position], sizeof(T));
+	position += sizeof(T);
+	return true;
+}
+
+inline bool ExtractString(const ArrayList<char>& in, size_t& position, String& value)
+{
+	UInt length = 0;
+	if (!Extract(in, position, length) || position + length > in.size())
+		return false;
+
+	value.assign(in.data() + position, length);
+	position += length;
+	return true;
+}
+}
+
+///////////////////////////////////////////////////////////
+// BinaryLogger
+///////////////////////////////////////////////////////////
+
+BinaryLogger::BinaryLogger()
+	: mOpen(false), mLevel(DEBUG_LOG), mBufferSize(64 * 1024), mpFile(nullptr)
+{
+}
+
+BinaryLogger::~BinaryLogger()
+{
+	Close();
+
+	for (auto it = mBuffers.begin(); it != mBuffers.end(); it++)
+	{
+		SAFE_DELETE(it->second);
+	}
+}
+
+bool BinaryLogger::Open(const String& path, UInt bufferSize)
+{
+	Close();
+
+	std::lock_guard<std::mutex> lock(mFileMutex);
+
+	mpFile = new io::BinaryFile();
+	if (!mpFile->Open(path, io::FileModes::Overwrite))
+	{
+		SAFE_DELETE(mpFile);
+		return false;
+	}
+
+	mpFile->Write(priv::BinaryLogMagic, sizeof(priv::BinaryLogMagic));
+	mpFile->Write(reinterpret_cast<const char*>( &BinaryLogVersion ), sizeof(UInt));
+
+	// Sites registered during an earlier session need to be described again
+	for (UInt i = 0; i < mFormats.size(); i++)
+		WriteFormat(i);
+
+	mBufferSize = bufferSize;
+	mOpen.store(true, std::memory_order_release);
+
+	return true;
+}
+
+void BinaryLogger::Close()
+{
+	if (!mOpen.exchange(false, std::memory_order_acq_rel))
+		return;
+
+	Flush();
+
+	std::lock_guard<std::mutex> lock(mFileMutex);
+	mpFile->Close();
+	SAFE_DELETE(mpFile);
+}
+
+void BinaryLogger::Flush()
+{
+	std::lock_guard<std::mutex> lock(mBuffersMutex);
+
+	for (auto it = mBuffers.begin(); it != mBuffers.end(); it++)
+	{
+		std::lock_guard<std::mutex> bufferLock(it->second->mutex);
+		FlushBuffer(*it->second);
+	}
+
+	std::lock_guard<std::mutex> fileLock(mFileMutex);
+	if (mpFile)
+		mpFile->Flush();
+}
+
+UInt BinaryLogger::Register(BinaryLogSite& site, const char* format, const Byte* types, UInt typeCount)
+{
+	std::lock_guard<std::mutex> lock(mFileMutex);
+
+	// Another thread may have got here first
+	UInt id = site.id.load(std::memory_order_acquire);
+	if (id != 0)
+		return id;
+
+	Format descriptor;
+	descriptor.site = &site;
+	descriptor.format = format;
+	descriptor.types.assign(types, types + typeCount);
+	mFormats.push_back(descriptor);
+
+	// The descriptor is written before any record using it can be flushed
+	if (mpFile)
+		WriteFormat(static_cast<UInt>( mFormats.size() - 1 ));
+
+	id = static_cast<UInt>( mFormats.size() );
+	site.id.store(id, std::memory_order_release);
+
+	return id;
+}
+
+void BinaryLogger::WriteFormat(UInt index)
+{
+	const Format& descriptor = mFormats[index];
+
+	ArrayList<char> chunk;
+	priv::Append(chunk, index + 1);
+	priv::Append(chunk, descriptor.site->line);
+	priv::AppendString(chunk, descriptor.format);
+	priv::AppendString(chunk, descriptor.site->function);
+	priv::AppendString(chunk, descriptor.site->file);
+	priv::Append(chunk, static_cast<Byte>( descriptor.types.size() ));
+	chunk.insert(chunk.end(), descriptor.types.begin(), descriptor.types.end());
+
+	WriteChunk(BINARY_CHUNK_FORMAT, chunk.data(), static_cast<UInt>( chunk.size() ));
+}
+
+void BinaryLogger::WriteChunk(BinaryChunkType type, const char* data, UInt size)
+{
+	Byte chunkType = type;
+	mpFile->Write(reinterpret_cast<const char*>( &chunkType ), sizeof(Byte));
+	mpFile->Write(reinterpret_cast<const char*>( &size ), sizeof(UInt));
+	mpFile->Write(data, size);
+}
+
+void BinaryLogger::FlushBuffer(priv::BinaryLogBuffer& buffer)
+{
+	if (buffer.used == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(mFileMutex);
+
+	if (mpFile)
+		WriteChunk(BINARY_CHUNK_RECORDS, buffer.data.data(), static_cast<UInt>( buffer.used ));
+
+	buffer.used = 0;
+}
+
+char* BinaryLogger::Reserve(priv::BinaryLogBuffer& buffer, size_t size)
+{
+	if (buffer.used + size > buffer.data.size())
+	{
+		FlushBuffer(buffer);
+
+		if (size > buffer.data.size())
+			buffer.data.resize(std::max<size_t>(size, mBufferSize));
+	}
+
+	char* out = &buffer.data[buffer.used];
+	buffer.used += size;
+	return out;
+}
+
+priv::BinaryLogBuffer& BinaryLogger::GetThreadBuffer()
+{
+	static thread_local const BinaryLogger* tpOwner = nullptr;
+	static thread_local priv::BinaryLogBuffer* tpBuffer = nullptr;
+
+	if (tpOwner == this)
+		return *tpBuffer;
+
+	// First call on this thread, buffers of finished threads get picked up again when the id is reused
+	ULong key = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+	std::lock_guard<std::mutex> lock(mBuffersMutex);
+
+	priv::BinaryLogBuffer*& buffer = mBuffers[key];
+	if (!buffer)
+	{
+		buffer = new priv::BinaryLogBuffer();
+		buffer->data.resize(mBufferSize);
+		buffer->used = 0;
+	}
+
+	tpOwner = this;
+	tpBuffer = buffer;
+
+	return *buffer;
+}
+
+///////////////////////////////////////////////////////////
+// BinaryLogReader
+///////////////////////////////////////////////////////////
+
+BinaryLogReader::BinaryLogReader()
+	: mpFile(nullptr), mChunkPosition(0)
+{
+}
+
+BinaryLogReader::~BinaryLogReader()
+{
+	SAFE_DELETE(mpFile);
+}
+
+bool BinaryLogReader::Open(const String& path)
+{
+	SAFE_DELETE(mpFile);
+	mFormats.clear();
+	mChunk.clear();
+	mChunkPosition = 0;
+
+	mpFile = new io::BinaryFile();
+	if (!mpFile->Open(path, io::FileModes::Read))
+		return false;
+
+	char magic[4];
+	UInt version = 0;
+	if (!mpFile->Read(magic, sizeof(magic)) || !mpFile->Read(reinterpret_cast<char*>( &version ), sizeof(UInt)))
+		return false;
+
+	if (std::memcmp(magic, priv::BinaryLogMagic, sizeof(magic)) != 0 || version != BinaryLogVersion)
+	{
+		KL_WARNING("'" + path + "' is not a binary log or has an unsupported version");
+		return false;
+	}
+
+	return true;
+}
+
+bool BinaryLogReader::Next(LogEntry& entry)
+{
+	while (mChunkPosition >= mChunk.size())
+	{
+		if (!ReadChunk())
+			return false;
+	}
+
+	UInt id = 0;
+	Byte level = 0;
+	ULong timestamp = 0;
+	if (!priv::Extract(mChunk, mChunkPosition, id) ||
+		!priv::Extract(mChunk, mChunkPosition, level) ||
+		!priv::Extract(mChunk, mChunkPosition, timestamp))
+		return false;
+
+	auto found = mFormats.find(id);
+	if (found == mFormats.end())
+	{
+		KL_WARNING("Binary log record references unknown format " + klib::ToString(id));
+		return false;
+	}
+
+	const Format& format = found->second;
+
+	// Convert each argument to text, then splice them in place of "{}"
+	ArrayList<String> arguments;
+	for (Byte type : format.types)
+	{
+		switch (type)
+		{
+			case BINARY_ARG_BOOL: { char value; if (!priv::Extract(mChunk, mChunkPosition, value)) return false; arguments.push_back(klib::ToString<bool>(value != 0)); break; }
+			case BINARY_ARG_CHAR: { char value; if (!priv::Extract(mChunk, mChunkPosition, value)) return false; arguments.push_back(String(1, value)); break; }
+			case BINARY_ARG_INT32: { Int value; if (!priv::Extract(mChunk, mChunkPosition, value)) return false; arguments.push_back(klib::ToString(value)); break; }
+			case BINARY_ARG_UINT32: { UInt value; if (!priv::Extract(mChunk, mChunkPosition, value)) return false; arguments.push_back(klib::ToString(value)); break; }
+			case BINARY_ARG_INT64: { Long value; if (!priv::Extract(mChunk, mChunkPosition, value)) return false; arguments.push_back(klib::ToString(value)); break; }
+			case BINARY_ARG_UINT64: { ULong value; if (!priv::Extract(mChunk, mChunkPosition, value)) return false; arguments.push_back(klib::ToString(value)); break; }
+			case BINARY_ARG_FLOAT: { Float value; if (!priv::Extract(mChunk, mChunkPosition, value)) return false; arguments.push_back(klib::ToString(value)); break; }
+			case BINARY_ARG_DOUBLE: { Double value; if (!priv::Extract(mChunk, mChunkPosition, value)) return false; arguments.push_back(klib::ToString(value)); break; }
+			case BINARY_ARG_STRING: { String value; if (!priv::ExtractString(mChunk, mChunkPosition, value)) return false; arguments.push_back(value); break; }
+			default: return false;
+		}
+	}
+
+	String message;
+	size_t argument = 0;
+	for (size_t i = 0; i < format.format.size(); i++)
+	{
+		if (format.format[i] == '{' && i + 1 < format.format.size() && format.format[i + 1] == '}' && argument < arguments.size())
+		{
+			message += arguments[argument++];
+			i++;
+		}
+		else
+		{
+			message += format.format[i];
+		}
+	}
+
+	entry.level = static_cast<LogLevel>( level );
+	entry.message.Assign(message);
+	entry.fields.Clear(); // The entry may be reused, records have no fields
+	entry.timestamp = timestamp;
+	entry.clock = TIME_SYSTEM_CLOCK;
+	entry.source = &format.source;
+
+	return true;
+}
+
+bool BinaryLogReader::ReadChunk()
+{
+	Byte type = 0;
+	UInt size = 0;
+	if (!mpFile || !mpFile->Read(reinterpret_cast<char*>( &type ), sizeof(Byte)) || !mpFile->Read(reinterpret_cast<char*>( &size ), sizeof(UInt)))
+		return false;
+
+	mChunk.resize(size);
+	mChunkPosition = 0;
+	if (size > 0 && !mpFile->Read(mChunk.data(), size))
+		return false;
+
+	if (type == BINARY_CHUNK_FORMAT)
+	{
+		bool valid = ReadFormat();
+		mChunk.clear();
+		return valid;
+	}
+
+	return type == BINARY_CHUNK_RECORDS;
+}
+
+bool BinaryLogReader::ReadFormat()
+{
+	UInt id = 0;
+	Byte typeCount = 0;
+	Format format;
+
+	if (!priv::Extract(mChunk, mChunkPosition, id) ||
+		!priv::Extract(mChunk, mChunkPosition, format.line) ||
+		!priv::ExtractString(mChunk, mChunkPosition, format.format) ||
+		!priv::ExtractString(mChunk, mChunkPosition, format.function) ||
+		!priv::ExtractString(mChunk, mChunkPosition, format.file) ||
+		!priv::Extract(mChunk, mChunkPosition, typeCount) ||
+		mChunkPosition + typeCount > mChunk.size())
+	{
+		return false;
+	}
+
+	format.types.assign(mChunk.begin() + mChunkPosition, mChunk.begin() + mChunkPosition + typeCount);
+
+	// Map nodes don't move, so the location can point at the stored strings
+	Format& stored = mFormats[id];
+	stored = format;
+	stored.source.function = stored.function.c_str();
+	stored.source.file = stored.file.c_str();
+	stored.source.line = stored.line;
+	stored.source.category = nullptr;
+
+	return true;
+}
+
+} // logging
+} // klib
@@ -0,0 +1,189 @@
+#ifdef _WIN32
+#	include <io.h>
+#	include <fcntl.h>
+#	include <sys/stat.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+#include <atomic>
+#include <csignal>
+#include <cstring>
+
+#include <KLib/FlightRecorder.hpp>
+#include <KLib/CrashHandler.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+namespace priv
+{
+
+const int g_crashSignals[] = { SIGSEGV, SIGABRT, SIGFPE };
+const size_t g_crashSignalCount = sizeof(g_crashSignals) / sizeof(int);
+
+// Read by the signal handler, so everything is set up before the handler is installed
+std::atomic<FlightRecorder*> g_pCrashRecorder(nullptr);
+StrongPtr<FlightRecorder> g_crashRecorder; // Keeps g_pCrashRecorder alive
+char g_crashDumpPath[4096];
+
+#ifndef _WIN32
+// Lets the handler run after a stack overflow. Each thread needs its own, sigaltstack is per thread.
+struct AlternateStack
+{
+	static const size_t Size = 64 * 1024;
+
+	AlternateStack()
+		: pMemory(nullptr) {}
+
+	~AlternateStack()
+	{
+		if (!pMemory)
+			return;
+
+		stack_t stack;
+		std::memset(&stack, 0, sizeof(stack));
+		stack.ss_flags = SS_DISABLE;
+		sigaltstack(&stack, nullptr);
+		delete[] pMemory;
+	}
+
+	char* pMemory;
+};
+#endif
+
+inline void WriteText(int fd, const char* text)
+{
+#ifdef _WIN32
+	_write(fd, text, (unsigned)std::strlen(text));
+#else
+	if (write(fd, text, std::strlen(text)) < 0)
+		return;
+#endif
+}
+
+const char* GetSignalName(int signal)
+{
+	switch (signal)
+	{
+		case SIGSEGV: return "SIGSEGV";
+		case SIGABRT: return "SIGABRT";
+		case SIGFPE: return "SIGFPE";
+	}
+	return "signal";
+}
+
+void HandleCrash(int signal)
+{
+	FlightRecorder* recorder = g_pCrashRecorder.load(std::memory_order_acquire);
+
+	if (recorder)
+	{
+#ifdef _WIN32
+		int fd = _open(g_crashDumpPath, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+		int fd = open(g_crashDumpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+		if (fd >= 0)
+		{
+			WriteText(fd, "Caught ");
+			WriteText(fd, GetSignalName(signal));
+			WriteText(fd, ", last log entries:\n");
+
+			recorder->DumpTo(fd);
+
+#ifdef _WIN32
+			_close(fd);
+#else
+			close(fd);
+#endif
+		}
+	}
+
+	// Let the default action terminate the program as it would have
+	std::signal(signal, SIG_DFL);
+	std::raise(signal);
+}
+
+} // priv
+
+bool CrashHandler::Install(StrongPtr<FlightRecorder> recorder, const String& dumpPath)
+{
+	if (!recorder || dumpPath.size() >= sizeof(priv::g_crashDumpPath))
+		return false;
+
+	// Stop the old handler from dumping while the path is replaced
+	priv::g_pCrashRecorder.store(nullptr, std::memory_order_release);
+	std::memcpy(priv::g_crashDumpPath, dumpPath.c_str(), dumpPath.size() + 1);
+	priv::g_crashRecorder = recorder;
+	priv::g_pCrashRecorder.store(recorder.get(), std::memory_order_release);
+
+#ifdef _WIN32
+	for (size_t i = 0; i < priv::g_crashSignalCount; i++)
+	{
+		if (std::signal(priv::g_crashSignals[i], priv::HandleCrash) == SIG_ERR)
+			return false;
+	}
+#else
+	InstallThread();
+
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_handler = priv::HandleCrash;
+	action.sa_flags = SA_ONSTACK | SA_RESETHAND;
+	sigemptyset(&action.sa_mask);
+
+	for (size_t i = 0; i < priv::g_crashSignalCount; i++)
+	{
+		if (sigaction(priv::g_crashSignals[i], &action, nullptr) != 0)
+			return false;
+	}
+#endif
+
+	return true;
+}
+
+bool CrashHandler::InstallThread()
+{
+#ifdef _WIN32
+	return true;
+#else
+	static thread_local priv::AlternateStack tAlternateStack;
+	if (tAlternateStack.pMemory)
+		return true;
+
+	// Keep a big enough stack set up by someone else, e.g. a sanitizer
+	stack_t stack;
+	if (sigaltstack(nullptr, &stack) == 0 && !( stack.ss_flags & SS_DISABLE ) && stack.ss_size >= priv::AlternateStack::Size)
+		return true;
+
+	char* memory = new char[priv::AlternateStack::Size];
+	stack.ss_sp = memory;
+	stack.ss_size = priv::AlternateStack::Size;
+	stack.ss_flags = 0;
+
+	if (sigaltstack(&stack, nullptr) != 0)
+	{
+		delete[] memory;
+		return false;
+	}
+
+	tAlternateStack.pMemory = memory;
+	return true;
+#endif
+}
+
+void CrashHandler::Uninstall()
+{
+	for (size_t i = 0; i < priv::g_crashSignalCount; i++)
+		std::signal(priv::g_crashSignals[i], SIG_DFL);
+
+	priv::g_pCrashRecorder.store(nullptr, std::memory_order_release);
+	priv::g_crashRecorder.reset();
+}
+
+} // logging
+} // klib
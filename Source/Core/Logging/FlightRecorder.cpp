@@ -0,0 +1,191 @@
+#ifdef _WIN32
+#	include <io.h>
+#	include <fcntl.h>
+#	include <sys/stat.h>
+#	define KL_WRITE _write
+#	define KL_OPEN _open
+#	define KL_CLOSE _close
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	define KL_WRITE write
+#	define KL_OPEN open
+#	define KL_CLOSE close
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+#include <KLib/FlightRecorder.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+namespace priv
+{
+
+// Helpers below are async-signal-safe: no allocation, no locks, no stdio
+
+inline void WriteAll(int fd, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		int written = (int)KL_WRITE(fd, data, (unsigned)size);
+		if (written <= 0)
+			return;
+
+		data += written;
+		size -= written;
+	}
+}
+
+inline size_t FormatNumber(char* out, ULong value)
+{
+	char digits[20];
+	size_t count = 0;
+
+	do
+	{
+		digits[count++] = (char)( '0' + value % 10 );
+		value /= 10;
+	}
+	while (value > 0);
+
+	for (size_t i = 0; i < count; i++)
+		out[i] = digits[count - i - 1];
+
+	return count;
+}
+
+inline size_t AppendText(char* out, const char* text)
+{
+	size_t size = std::strlen(text);
+	std::memcpy(out, text, size);
+	return size;
+}
+
+} // priv
+
+FlightRecorder::FlightRecorder(UInt capacity)
+	: mPosition(0)
+{
+	ULong size = 2;
+	while (size < capacity)
+		size <<= 1;
+
+	mpRecords = new Record[size];
+	mMask = size - 1;
+
+	for (ULong i = 0; i < size; i++)
+		mpRecords[i].sequence.store(0, std::memory_order_relaxed);
+}
+
+FlightRecorder::~FlightRecorder(void)
+{
+	SAFE_DELETE_ARRAY(mpRecords);
+}
+
+bool FlightRecorder::Log(const LogEntry& entry)
+{
+	ULong slot = mPosition.fetch_add(1, std::memory_order_relaxed);
+	Record& record = mpRecords[slot & mMask];
+
+	// Mark the record as being written, a dump in progress will skip it
+	record.sequence.store(slot * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	UInt size = std::min<UInt>(entry.message.GetSize(), KL_FLIGHT_RECORD_MESSAGE);
+	record.timestamp = entry.timestamp;
+	record.clock = static_cast<Byte>( entry.clock );
+	record.source = entry.source;
+	record.level = static_cast<Byte>( entry.level );
+	record.size = static_cast<UShort>( size );
+	std::memcpy(record.message, entry.message.GetData(), size);
+
+	record.sequence.store(( slot + 1 ) * 2, std::memory_order_release);
+
+	return true;
+}
+
+void FlightRecorder::DumpTo(int fd) const
+{
+	ULong end = mPosition.load(std::memory_order_acquire);
+	ULong start = ( end > mMask + 1 ) ? end - ( mMask + 1 ) : 0;
+
+	// timestamp, level, source line and separators
+	char line[64];
+
+	for (ULong slot = start; slot < end; slot++)
+	{
+		const Record& record = mpRecords[slot & mMask];
+
+		ULong sequence = record.sequence.load(std::memory_order_acquire);
+		if (sequence != ( slot + 1 ) * 2)
+			continue;
+
+		ULong timestamp = record.timestamp;
+		Byte clock = record.clock;
+		const SourceLocation* source = record.source;
+		Byte level = record.level;
+		UShort size = std::min<UShort>(record.size, KL_FLIGHT_RECORD_MESSAGE);
+		char message[KL_FLIGHT_RECORD_MESSAGE];
+		std::memcpy(message, record.message, size);
+
+		// Overwritten while we were copying it
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (record.sequence.load(std::memory_order_relaxed) != sequence)
+			continue;
+
+		// Tick conversion is lock-free, fine inside a signal handler
+		if (clock == TIME_CYCLE_COUNTER)
+			timestamp = time::CycleClock::ToNanoseconds(timestamp);
+
+		size_t length = priv::FormatNumber(line, timestamp);
+		length += priv::AppendText(line + length, " [");
+		length += priv::AppendText(line + length, LogEntry::GetLevelName(static_cast<LogLevel>( level )));
+		length += priv::AppendText(line + length, "] ");
+		priv::WriteAll(fd, line, length);
+
+		if (source && source->category)
+		{
+			priv::WriteAll(fd, source->category->GetName(), std::strlen(source->category->GetName()));
+			priv::WriteAll(fd, ": ", 2);
+		}
+
+		priv::WriteAll(fd, message, size);
+
+		// Source strings are static, they can be written straight from where they are
+		if (source && source->file)
+		{
+			priv::WriteAll(fd, " (", 2);
+			priv::WriteAll(fd, source->file, std::strlen(source->file));
+			length = priv::AppendText(line, ":");
+			length += priv::FormatNumber(line + length, source->line);
+			length += priv::AppendText(line + length, ")");
+			priv::WriteAll(fd, line, length);
+		}
+
+		priv::WriteAll(fd, "\n", 1);
+	}
+}
+
+bool FlightRecorder::Dump(const String& path) const
+{
+#ifdef _WIN32
+	int fd = KL_OPEN(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+	int fd = KL_OPEN(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+	if (fd < 0)
+		return false;
+
+	DumpTo(fd);
+	KL_CLOSE(fd);
+
+	return true;
+}
+
+} // logging
+} // klib
@@ -0,0 +1,122 @@
+
+#include <algorithm>
+#include <mutex>
+
+#include <KLib/Map.hpp>
+#include <KLib/Logging.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+namespace priv
+{
+
+struct LogCategoryRegistry
+{
+	LogCategoryRegistry()
+	{
+#if defined(NDEBUG)
+		rootLevel = INFO_LOG;
+#else
+		rootLevel = DEBUG_LOG;
+#endif
+	}
+
+	// Level set for the category or its closest parent, "io.file" falls back to "io" then ""
+	LogLevel Resolve(String name) const
+	{
+		while (true)
+		{
+			auto it = levels.find(name);
+			if (it != levels.end())
+				return it->second;
+
+			if (name.empty())
+				return rootLevel;
+
+			size_t dot = name.rfind('.');
+			name.resize(dot == String::npos ? 0 : dot);
+		}
+	}
+
+	// Only recomputes the cached levels, categories are only added or changed outside the hot path
+	void Update()
+	{
+		for (auto it = categories.begin(); it != categories.end(); it++)
+			( *it )->mLevel.store(static_cast<Byte>( Resolve(( *it )->mpName) ), std::memory_order_relaxed);
+	}
+
+	void Add(LogCategory* category)
+	{
+		categories.push_back(category);
+		category->mLevel.store(static_cast<Byte>( Resolve(category->mpName) ), std::memory_order_relaxed);
+	}
+
+	void Remove(LogCategory* category)
+	{
+		categories.erase(std::remove(categories.begin(), categories.end(), category), categories.end());
+	}
+
+	std::mutex mutex;
+	ArrayList<LogCategory*> categories;
+	Map<String, LogLevel> levels; // Levels set explicitly, may name categories which don't exist yet
+	LogLevel rootLevel;
+};
+
+// Categories are globals in other translation units, so the registry is created on first use
+LogCategoryRegistry& GetLogCategoryRegistry()
+{
+	static LogCategoryRegistry registry;
+	return registry;
+}
+
+} // priv
+
+LogCategory::LogCategory(const char* name)
+	: mpName(name), mLevel(DEBUG_LOG)
+{
+	priv::LogCategoryRegistry& registry = priv::GetLogCategoryRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.Add(this);
+}
+
+LogCategory::~LogCategory(void)
+{
+	priv::LogCategoryRegistry& registry = priv::GetLogCategoryRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.Remove(this);
+}
+
+void LogCategory::SetLevel(const String& name, LogLevel level)
+{
+	priv::LogCategoryRegistry& registry = priv::GetLogCategoryRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	registry.levels[name] = level;
+	registry.Update();
+}
+
+void LogCategory::ResetLevel(const String& name)
+{
+	priv::LogCategoryRegistry& registry = priv::GetLogCategoryRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	registry.levels.erase(name);
+	registry.Update();
+}
+
+const LogCategory* LogCategory::Find(const String& name)
+{
+	priv::LogCategoryRegistry& registry = priv::GetLogCategoryRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	for (auto it = registry.categories.begin(); it != registry.categories.end(); it++)
+		if (name == ( *it )->mpName)
+			return *it;
+	return nullptr;
+}
+
+} // logging
+} // klib
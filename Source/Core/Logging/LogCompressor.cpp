@@ -0,0 +1,266 @@
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <sys/resource.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+
+#include <KLib/Thread.hpp>
+#include <KLib/LogCompressor.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+namespace priv
+{
+
+inline bool FileExists(const String& path)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	return _stat64(path.c_str(), &info) == 0;
+#else
+	struct stat info;
+	return stat(path.c_str(), &info) == 0;
+#endif
+}
+
+// Lowest CPU and IO priority for the calling thread, failures are harmless
+void LowerThreadPriority()
+{
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__linux__)
+	// Linux applies nice values and IO priorities per thread
+	pid_t thread = static_cast<pid_t>( syscall(SYS_gettid) );
+	setpriority(PRIO_PROCESS, thread, 19);
+
+#	if defined(SYS_ioprio_set)
+	const int ioprioWhoProcess = 1;
+	const int ioprioClassIdle = 3;
+	syscall(SYS_ioprio_set, ioprioWhoProcess, thread, ioprioClassIdle << 13);
+#	endif
+#elif defined(__APPLE__)
+	// Background band, throttles CPU and disk for this thread only
+	setpriority(PRIO_DARWIN_THREAD, 0, PRIO_DARWIN_BG);
+#else
+	// Nice values are per process here, renicing would slow down the whole program
+#endif
+}
+
+class CompressorWorker : public Thread
+{
+public:
+	CompressorWorker(LogCompressor& compressor)
+		: mCompressor(compressor) {}
+
+	void* Run() override
+	{
+		LowerThreadPriority();
+
+		std::unique_lock<std::mutex> lock(mCompressor.mMutex);
+
+		while (true)
+		{
+			mCompressor.mCondition.wait(lock, [this] { return !mCompressor.mQueue.empty() || mCompressor.mStopping; });
+
+			if (mCompressor.mQueue.empty())
+				break; // Stopping, and nothing left to do
+
+			String path = mCompressor.mQueue.front();
+			mCompressor.mQueue.pop_front();
+			mCompressor.mBusy = true;
+
+			lock.unlock();
+			String compressed = path + LogCompressor::Extension;
+			if (LogCompressor::CompressFile(path, compressed, mCompressor.mBlockSize))
+			{
+				// Deleted while we were compressing it, e.g. by RotatingLogWriter's retention
+				if (!FileExists(path))
+					std::remove(compressed.c_str());
+				else if (mCompressor.mRemoveOriginal)
+					std::remove(path.c_str());
+			}
+			else
+			{
+				KL_WARNING("Could not compress log '" + path + "'");
+			}
+			lock.lock();
+
+			mCompressor.mBusy = false;
+			mCompressor.mCondition.notify_all();
+		}
+
+		return nullptr;
+	}
+
+private:
+	LogCompressor& mCompressor;
+};
+
+template<typename T>
+inline bool ExtractRaw(const String& record, size_t& position, T& value)
+{
+	if (record.size() - position < sizeof(T))
+		return false;
+
+	std::memcpy(&value, record.data() + position, sizeof(T));
+	position += sizeof(T);
+	return true;
+}
+
+} // priv
+
+const char* const LogCompressor::Extension = ".klz";
+
+LogCompressor::LogCompressor(bool removeOriginal, UInt blockSize)
+	: mRemoveOriginal(removeOriginal), mBlockSize(blockSize), mBusy(false), mStopping(false),
+	mpWorker(new priv::CompressorWorker(*this))
+{
+	mpWorker->Start();
+}
+
+LogCompressor::~LogCompressor(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mCondition.notify_all();
+
+	mpWorker->Stop();
+	SAFE_DELETE(mpWorker);
+}
+
+void LogCompressor::Compress(const String& path)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQueue.push_back(path);
+	}
+	mCondition.notify_all();
+}
+
+void LogCompressor::Wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mCondition.wait(lock, [this] { return mQueue.empty() && !mBusy; });
+}
+
+bool LogCompressor::CompressFile(const String& source, const String& destination, UInt blockSize)
+{
+	std::FILE* input = std::fopen(source.c_str(), "rb");
+	if (!input)
+		return false;
+
+	String temporary = destination + ".tmp";
+	io::CompressedWriter writer;
+	bool result = writer.Open(temporary, blockSize);
+
+	ArrayList<char> buffer(blockSize > 0 ? blockSize : 1);
+	while (result)
+	{
+		size_t read = std::fread(buffer.data(), 1, buffer.size(), input);
+		if (read == 0)
+			break;
+
+		result = writer.Write(buffer.data(), read);
+	}
+
+	result = !std::ferror(input) && result;
+	std::fclose(input);
+	result = writer.Close() && result;
+
+	if (result)
+	{
+		// Rename doesn't replace an existing file everywhere
+		std::remove(destination.c_str());
+		result = std::rename(temporary.c_str(), destination.c_str()) == 0;
+	}
+
+	if (!result)
+		std::remove(temporary.c_str());
+
+	return result;
+}
+
+bool CompressedLogReader::Open(const String& path)
+{
+	return mReader.Open(path);
+}
+
+bool CompressedLogReader::NextLine(String& line)
+{
+	return mReader.ReadLine(line);
+}
+
+bool CompressedLogReader::Next(LogEntry& entry)
+{
+	// See LogEntry::AppendBinary for the layout
+	UInt size = 0;
+	if (mReader.Read(reinterpret_cast<char*>( &size ), sizeof(UInt)) != sizeof(UInt))
+		return false;
+
+	mRecord.resize(size);
+	if (size > 0 && mReader.Read(&mRecord[0], size) != size)
+		return false;
+
+	size_t position = 0;
+	ULong timestamp = 0;
+	Byte level = 0;
+	UShort categorySize = 0;
+	UInt messageSize = 0;
+	UInt fieldsSize = 0;
+
+	if (!priv::ExtractRaw(mRecord, position, timestamp) ||
+		!priv::ExtractRaw(mRecord, position, level) ||
+		!priv::ExtractRaw(mRecord, position, categorySize) ||
+		size - position < categorySize)
+		return false;
+	mCategory.assign(mRecord.data() + position, categorySize);
+	position += categorySize;
+
+	if (!priv::ExtractRaw(mRecord, position, messageSize) || size - position < messageSize)
+		return false;
+	entry.message.Assign(mRecord.data() + position, messageSize);
+	position += messageSize;
+
+	if (!priv::ExtractRaw(mRecord, position, fieldsSize) || size - position < fieldsSize)
+		return false;
+	entry.fields.Clear();
+	entry.fields.Append(mRecord.data() + position, fieldsSize);
+
+	entry.level = static_cast<LogLevel>( level );
+	entry.timestamp = timestamp;
+	entry.clock = TIME_SYSTEM_CLOCK;
+	entry.source = FindSource();
+
+	return true;
+}
+
+const SourceLocation* CompressedLogReader::FindSource()
+{
+	if (mCategory.empty())
+		return nullptr;
+
+	auto it = mSources.find(mCategory);
+	if (it == mSources.end())
+	{
+		SourceLocation source = { nullptr, nullptr, 0, LogCategory::Find(mCategory) };
+		it = mSources.insert(std::make_pair(mCategory, source)).first;
+	}
+
+	return it->second.category ? &it->second : nullptr;
+}
+
+} // logging
+} // klib
@@ -0,0 +1,264 @@
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <KLib/Logging.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+namespace priv
+{
+
+template<typename T>
+inline void AppendRaw(String& out, T value)
+{
+	out.append(reinterpret_cast<const char*>( &value ), sizeof(T));
+}
+
+inline void AppendNumber(String& out, const LogField& field)
+{
+	char text[32];
+	int size = 0;
+
+	switch (field.type)
+	{
+		case FIELD_INT: size = std::snprintf(text, sizeof(text), "%lld", (long long)field.integer); break;
+		case FIELD_UINT: size = std::snprintf(text, sizeof(text), "%llu", (unsigned long long)field.unsignedInteger); break;
+		case FIELD_FLOAT: size = std::snprintf(text, sizeof(text), "%.17g", field.real); break;
+		case FIELD_DURATION: size = std::snprintf(text, sizeof(text), "%lld", (long long)field.nanoseconds); break;
+		case FIELD_STRING: break;
+	}
+
+	out.append(text, size > 0 ? size : 0);
+}
+
+void AppendJsonString(String& out, const char* text, size_t size)
+{
+	out += '"';
+	for (size_t i = 0; i < size; i++)
+	{
+		char c = text[i];
+		switch (c)
+		{
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>( c ) < 0x20)
+				{
+					char escaped[8];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					out += escaped;
+				}
+				else
+				{
+					out += c;
+				}
+		}
+	}
+	out += '"';
+}
+
+inline void AppendJsonString(String& out, const char* text)
+{
+	AppendJsonString(out, text, std::strlen(text));
+}
+
+} // priv
+
+void LogFields::Add(const LogField& field)
+{
+	// Encoded in a local buffer first so the common case is one copy
+	char encoded[KL_LOG_INLINE_FIELDS];
+	size_t keySize = std::strlen(field.key) + 1;
+	size_t size = 1 + keySize + ( field.type == FIELD_STRING ? sizeof(UInt) + field.textSize : sizeof(ULong) );
+
+	if (size > sizeof(encoded))
+	{
+		String spilled;
+		spilled += static_cast<char>( field.type );
+		spilled.append(field.key, keySize);
+		if (field.type == FIELD_STRING)
+		{
+			priv::AppendRaw(spilled, field.textSize);
+			spilled.append(field.text, field.textSize);
+		}
+		else
+		{
+			priv::AppendRaw(spilled, field.unsignedInteger);
+		}
+		Append(spilled.data(), spilled.size());
+		return;
+	}
+
+	size_t position = 0;
+	encoded[position++] = static_cast<char>( field.type );
+	std::memcpy(encoded + position, field.key, keySize);
+	position += keySize;
+
+	if (field.type == FIELD_STRING)
+	{
+		std::memcpy(encoded + position, &field.textSize, sizeof(UInt));
+		std::memcpy(encoded + position + sizeof(UInt), field.text, field.textSize);
+	}
+	else
+	{
+		// Every other type is 8 bytes in the union
+		std::memcpy(encoded + position, &field.unsignedInteger, sizeof(ULong));
+	}
+
+	Append(encoded, size);
+}
+
+bool LogFields::Next(UInt& position, LogField& field) const
+{
+	const char* data = GetData();
+	if (position >= mSize)
+		return false;
+
+	field.type = static_cast<LogFieldType>( data[position++] );
+	field.key = data + position;
+	position += static_cast<UInt>( std::strlen(field.key) ) + 1;
+
+	if (field.type == FIELD_STRING)
+	{
+		std::memcpy(&field.textSize, data + position, sizeof(UInt));
+		field.text = data + position + sizeof(UInt);
+		position += sizeof(UInt) + field.textSize;
+	}
+	else
+	{
+		std::memcpy(&field.unsignedInteger, data + position, sizeof(ULong));
+		field.text = nullptr;
+		field.textSize = 0;
+		position += sizeof(ULong);
+	}
+
+	return true;
+}
+
+void LogEntry::AppendTo(String& out) const
+{
+	out += klib::ToString(GetNanoseconds());
+	out += " [";
+	out += GetLevelName(level);
+	out += "] ";
+	if (source && source->category)
+	{
+		out += source->category->GetName();
+		out += ": ";
+	}
+	out.append(message.GetData(), message.GetSize());
+
+	UInt position = 0;
+	LogField field;
+	while (fields.Next(position, field))
+	{
+		out += ' ';
+		out += field.key;
+		out += '=';
+
+		if (field.type == FIELD_STRING)
+			priv::AppendJsonString(out, field.text, field.textSize);
+		else
+			priv::AppendNumber(out, field);
+
+		if (field.type == FIELD_DURATION)
+			out += "ns";
+	}
+}
+
+void LogEntry::AppendJson(String& out) const
+{
+	out += "{\"time\":";
+	out += klib::ToString(GetNanoseconds());
+	out += ",\"level\":\"";
+	out += GetLevelName(level);
+	out += '"';
+
+	if (source && source->category)
+	{
+		out += ",\"category\":";
+		priv::AppendJsonString(out, source->category->GetName());
+	}
+
+	out += ",\"message\":";
+	priv::AppendJsonString(out, message.GetData(), message.GetSize());
+
+	if (source && source->file)
+	{
+		out += ",\"file\":";
+		priv::AppendJsonString(out, source->file);
+		out += ",\"line\":";
+		out += klib::ToString(source->line);
+	}
+
+	UInt position = 0;
+	LogField field;
+	while (fields.Next(position, field))
+	{
+		out += ',';
+		priv::AppendJsonString(out, field.key);
+		out += ':';
+
+		if (field.type == FIELD_STRING)
+			priv::AppendJsonString(out, field.text, field.textSize);
+		else if (field.type == FIELD_FLOAT && !std::isfinite(field.real))
+			out += "null"; // JSON has no NaN or infinity
+		else
+			priv::AppendNumber(out, field);
+	}
+
+	out += '}';
+}
+
+void LogEntry::AppendBinary(String& out) const
+{
+	const char* category = ( source && source->category ) ? source->category->GetName() : "";
+	UShort categorySize = static_cast<UShort>( std::strlen(category) );
+
+	UInt size = static_cast<UInt>( sizeof(ULong) + sizeof(Byte) +
+		sizeof(UShort) + categorySize +
+		sizeof(UInt) + message.GetSize() +
+		sizeof(UInt) + fields.GetSize() );
+
+	out.reserve(out.size() + sizeof(UInt) + size);
+	priv::AppendRaw(out, size);
+	priv::AppendRaw(out, GetNanoseconds());
+	priv::AppendRaw(out, static_cast<Byte>( level ));
+	priv::AppendRaw(out, categorySize);
+	out.append(category, categorySize);
+	priv::AppendRaw(out, message.GetSize());
+	out.append(message.GetData(), message.GetSize());
+	priv::AppendRaw(out, fields.GetSize());
+	out.append(fields.GetData(), fields.GetSize());
+}
+
+void LogEntry::Format(String& out, LogFormat format) const
+{
+	switch (format)
+	{
+		case LOG_FORMAT_TEXT:
+			AppendTo(out);
+			out += '\n';
+			break;
+
+		case LOG_FORMAT_JSON:
+			AppendJson(out);
+			out += '\n';
+			break;
+
+		case LOG_FORMAT_BINARY:
+			AppendBinary(out);
+			break;
+	}
+}
+
+} // logging
+} // klib
@@ -0,0 +1,146 @@
+#include <thread>
+#include <utility>
+
+#include <KLib/LogQueue.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+LogQueue::LogQueue(UInt capacity, OverflowPolicy policy)
+	: mPolicy(policy), mEnqueuePosition(0), mDequeuePosition(0), mDropped(0)
+{
+	// Round up to a power of two so positions wrap with a mask
+	size_t size = 2;
+	while (size < capacity)
+		size <<= 1;
+
+	mpCells = new Cell[size];
+	mMask = size - 1;
+
+	for (size_t i = 0; i < size; i++)
+		mpCells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+LogQueue::~LogQueue()
+{
+	SAFE_DELETE_ARRAY(mpCells);
+}
+
+bool LogQueue::Push(LogEntry& entry)
+{
+	while (!TryPush(entry))
+	{
+		switch (mPolicy)
+		{
+			case OVERFLOW_DROP_NEWEST:
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+
+			case OVERFLOW_DROP_OLDEST:
+			{
+				// Make room by throwing away whatever is at the head
+				LogEntry oldest;
+				if (TryPop(oldest))
+					mDropped.fetch_add(1, std::memory_order_relaxed);
+				break;
+			}
+
+			case OVERFLOW_BLOCK:
+			default:
+				std::this_thread::yield();
+				break;
+		}
+	}
+
+	return true;
+}
+
+UInt LogQueue::PopBatch(ArrayList<LogEntry>& batch, UInt maxCount)
+{
+	UInt count = 0;
+	LogEntry entry;
+
+	while (count < maxCount && TryPop(entry))
+	{
+		batch.push_back(std::move(entry));
+		count++;
+	}
+
+	return count;
+}
+
+bool LogQueue::IsEmpty() const
+{
+	size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+	const Cell& cell = mpCells[position & mMask];
+	return cell.sequence.load(std::memory_order_acquire) != position + 1;
+}
+
+bool LogQueue::TryPush(LogEntry& entry)
+{
+	size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		Cell& cell = mpCells[position & mMask];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		std::ptrdiff_t difference = (std::ptrdiff_t)sequence - (std::ptrdiff_t)position;
+
+		if (difference == 0)
+		{
+			// Slot is free, try to claim it
+			if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				cell.entry = std::move(entry);
+				cell.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			// Slot still holds an entry from the previous lap, full
+			return false;
+		}
+		else
+		{
+			position = mEnqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool LogQueue::TryPop(LogEntry& entry)
+{
+	size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		Cell& cell = mpCells[position & mMask];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		std::ptrdiff_t difference = (std::ptrdiff_t)sequence - (std::ptrdiff_t)( position + 1 );
+
+		if (difference == 0)
+		{
+			// CAS rather than a plain store, producers pop too when dropping the oldest entry
+			if (mDequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				entry = std::move(cell.entry);
+				cell.sequence.store(position + mMask + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			// Nothing published here yet, empty
+			return false;
+		}
+		else
+		{
+			position = mDequeuePosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+} // logging
+} // klib
@@ -1,26 +1,285 @@
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
 #include <KLib/Time.hpp>
 #include <KLib/Logging.hpp>
+#include <KLib/LogQueue.hpp>
 #include <KLib/File.hpp>
+#include <KLib/Thread.hpp>
 
 namespace klib
 {
+
+logging::Logger DefaultLogger;
+
 namespace logging
 {
 
-void Logger::Log(LogLevel level, String message, String func, String file, UInt line)
+namespace priv
+{
+
+class AsyncLogWorker : public Thread
+{
+public:
+	AsyncLogWorker(Logger& logger, LogQueue& queue, UInt batchSize)
+		: mLogger(logger), mQueue(queue), mBatchSize(batchSize)
+	{
+		mBatch.reserve(batchSize);
+	}
+
+	void* Run() override
+	{
+		UInt idleRounds = 0;
+		std::chrono::steady_clock::time_point nextFlush = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+		while (mRunning)
+		{
+			// Rate limited sites which went quiet would otherwise never report what they dropped
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (now >= nextFlush)
+			{
+				FlushSuppressed();
+				nextFlush = now + std::chrono::seconds(1);
+			}
+
+			if (Drain())
+			{
+				idleRounds = 0;
+			}
+			else if (++idleRounds < 64)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				// Nothing has been logged for a while, stop burning a core
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		// Write out whatever was queued before we were stopped
+		while (Drain()) {}
+		FlushSuppressed();
+
+		return nullptr;
+	}
+
+private:
+	// Dispatched right here, pushing onto a full queue would wait for ourselves
+	void FlushSuppressed()
+	{
+		mBatch.clear();
+		mLogger.CollectSuppressed(mBatch);
+
+		if (!mBatch.empty())
+			mLogger.Dispatch(mBatch.data(), static_cast<UInt>( mBatch.size() ));
+	}
+
+	bool Drain()
+	{
+		mBatch.clear();
+		UInt count = mQueue.PopBatch(mBatch, mBatchSize);
+
+		if (count > 0)
+			mLogger.Dispatch(mBatch.data(), count);
+
+		return count > 0;
+	}
+
+	Logger& mLogger;
+	LogQueue& mQueue;
+	UInt mBatchSize;
+	ArrayList<LogEntry> mBatch;
+};
+
+// Passes on runs of entries at or above the listener's level
+bool DispatchFiltered(LogListener& listener, const LogEntry* entries, UInt count)
 {
+	bool result = true;
+	UInt first = 0;
+
+	for (UInt i = 0; i <= count; i++)
+	{
+		if (i < count && entries[i].level >= listener.GetLevel())
+			continue;
+
+		if (i > first)
+			result = listener.LogBatch(entries + first, i - first) && result;
+
+		first = i + 1;
+	}
+
+	return result;
+}
+
+} // priv
+
+Logger::Logger()
+	: mTimeSource(TIME_SYSTEM_CLOCK), mpListeners(new ListenerList()), mEpoch(0), mpQueue(nullptr), mpWorker(nullptr), mDroppedBefore(0)
+{
+	mReaders[0].store(0, std::memory_order_relaxed);
+	mReaders[1].store(0, std::memory_order_relaxed);
+
+#if defined(NDEBUG)
+	mLevel.store(INFO_LOG, std::memory_order_relaxed);
+#else
+	mLevel.store(DEBUG_LOG, std::memory_order_relaxed);
+#endif
+}
+
+Logger::~Logger(void)
+{
+	StopAsync();
+	FlushSuppressed();
+	delete mpListeners.load(std::memory_order_relaxed);
+}
+
+UInt Logger::EnterRead() const
+{
+	while (true)
+	{
+		UInt epoch = mEpoch.load() & 1;
+		mReaders[epoch].fetch_add(1);
+
+		// A writer flipped the epoch in between, it may already have stopped waiting for this counter
+		if (( mEpoch.load() & 1 ) == epoch)
+			return epoch;
+
+		mReaders[epoch].fetch_sub(1);
+	}
+}
+
+void Logger::ExitRead(UInt epoch) const
+{
+	mReaders[epoch].fetch_sub(1);
+}
+
+void Logger::Synchronize()
+{
+	// New readers enter the other epoch, wait for the ones which could still hold the old state
+	UInt epoch = mEpoch.fetch_add(1) & 1;
+	while (mReaders[epoch].load() != 0)
+		std::this_thread::yield();
+}
+
+void Logger::Log(LogLevel level, const SourceLocation& source, const char* message, size_t size,
+	const LogField* fields, UInt fieldCount)
+{
+	// Categorized call sites are filtered by their category instead
+	if (source.category ? !source.category->IsEnabled(level) : !IsEnabled(level))
+		return;
+
 	LogEntry entry;
 	entry.level = level;
-	entry.message = message;
-	entry.sourceFunction = func;
-	entry.sourceFile = file;
-	entry.sourceLine = line;
-	entry.timestamp = klib::time::GetCurrentTime<klib::time::nanoseconds>();
+	entry.message.Assign(message, size);
+	for (UInt i = 0; i < fieldCount; i++)
+		entry.fields.Add(fields[i]);
+	entry.source = &source;
+	Stamp(entry);
+
+	UInt epoch = EnterRead();
+
+	LogQueue* queue = mpQueue.load(std::memory_order_acquire);
+	if (queue)
+		queue->Push(entry);
+	else
+		DispatchTo(*mpListeners.load(std::memory_order_acquire), &entry, 1);
+
+	ExitRead(epoch);
+}
+
+void Logger::LogSuppressed(LogLevel level, const SourceLocation& source, UInt count)
+{
+	char message[64];
+	int size = std::snprintf(message, sizeof(message), "Last message repeated %u times", count);
+	Log(level, source, message, size);
+}
+
+void Logger::TrackSuppressed(LogLevel level, const SourceLocation& source, RateLimiter& limiter)
+{
+	SuppressedSite site = { level, &source, &limiter };
+
+	std::lock_guard<std::mutex> lock(mSuppressedMutex);
+	mSuppressedSites.push_back(site);
+}
 
-	for (auto it = mListeners.begin(); it != mListeners.end(); it++)
+void Logger::FlushSuppressed()
+{
+	ArrayList<LogEntry> entries;
+	CollectSuppressed(entries);
+
+	UInt epoch = EnterRead();
+
+	LogQueue* queue = mpQueue.load(std::memory_order_acquire);
+	if (queue)
+	{
+		for (LogEntry& entry : entries)
+			queue->Push(entry);
+	}
+	else if (!entries.empty())
+	{
+		DispatchTo(*mpListeners.load(std::memory_order_acquire), entries.data(), static_cast<UInt>( entries.size() ));
+	}
+
+	ExitRead(epoch);
+}
+
+void Logger::CollectSuppressed(ArrayList<LogEntry>& entries)
+{
+	std::lock_guard<std::mutex> lock(mSuppressedMutex);
+
+	for (const SuppressedSite& site : mSuppressedSites)
+	{
+		UInt count = site.limiter->TakeSuppressed();
+		if (count == 0 || !IsEnabled(site.level))
+			continue;
+
+		char message[64];
+		int size = std::snprintf(message, sizeof(message), "Last message repeated %u times", count);
+
+		entries.push_back(LogEntry());
+		LogEntry& entry = entries.back();
+		entry.level = site.level;
+		entry.message.Assign(message, size);
+		entry.source = site.source;
+		Stamp(entry);
+	}
+}
+
+void Logger::Stamp(LogEntry& entry) const
+{
+	entry.clock = GetTimeSource();
+	entry.timestamp = ( entry.clock == TIME_CYCLE_COUNTER )
+		? klib::time::CycleClock::Now()
+		: klib::time::GetCurrentTime<klib::time::nanoseconds>();
+}
+
+void Logger::Dispatch(const LogEntry* entries, UInt count)
+{
+	UInt epoch = EnterRead();
+	DispatchTo(*mpListeners.load(std::memory_order_acquire), entries, count);
+	ExitRead(epoch);
+}
+
+void Logger::DispatchTo(const ListenerList& listeners, const LogEntry* entries, UInt count)
+{
+	// Keeps tick conversion accurate, only reads the counter unless a recalibration is due
+	klib::time::CycleClock::Update();
+
+	for (auto it = listeners.begin(); it != listeners.end(); it++)
 	{
-		if (!it->get()->Log(entry))
+		LogListener* listener = it->get();
+		if (!listener->IsEnabled())
+			continue;
+
+		bool result = ( listener->GetLevel() == DEBUG_LOG )
+			? listener->LogBatch(entries, count)
+			: priv::DispatchFiltered(*listener, entries, count);
+
+		if (!result)
 		{
 			//is this ever valid?
 			break;
@@ -28,22 +287,98 @@ void Logger::Log(LogLevel level, String message, String func, String file, UInt
 	}
 }
 
-bool ErrorMessenger::Log(LogEntry entry)
+void Logger::SetTimeSource(TimeSource source)
+{
+	if (source == TIME_CYCLE_COUNTER && !klib::time::CycleClock::IsCalibrated())
+		klib::time::CycleClock::Calibrate();
+
+	mTimeSource.store(static_cast<Byte>( source ), std::memory_order_relaxed);
+}
+
+void Logger::AddListener(StrongPtr<LogListener> listener)
+{
+	std::lock_guard<std::mutex> lock(mWriterMutex);
+
+	ListenerList* listeners = new ListenerList(*mpListeners.load(std::memory_order_relaxed));
+	listeners->push_back(listener);
+
+	const ListenerList* old = mpListeners.exchange(listeners);
+	Synchronize();
+	delete old;
+}
+
+void Logger::RemoveListener(const StrongPtr<LogListener>& listener)
+{
+	std::lock_guard<std::mutex> lock(mWriterMutex);
+
+	ListenerList* listeners = new ListenerList(*mpListeners.load(std::memory_order_relaxed));
+	listeners->erase(std::remove(listeners->begin(), listeners->end(), listener), listeners->end());
+
+	const ListenerList* old = mpListeners.exchange(listeners);
+	Synchronize();
+	delete old;
+}
+
+bool Logger::StartAsync(UInt capacity, OverflowPolicy policy, UInt batchSize)
+{
+	std::lock_guard<std::mutex> lock(mWriterMutex);
+
+	if (IsAsync())
+		return false;
+
+	LogQueue* queue = new LogQueue(capacity, policy);
+	mpWorker = new priv::AsyncLogWorker(*this, *queue, std::max<UInt>(batchSize, 1));
+	mpWorker->Start();
+	mpQueue.store(queue, std::memory_order_release);
+
+	return true;
+}
+
+void Logger::StopAsync()
+{
+	std::lock_guard<std::mutex> lock(mWriterMutex);
+
+	LogQueue* queue = mpQueue.exchange(nullptr);
+	if (!queue)
+		return;
+
+	// Wait for threads still pushing onto the queue, then join once the worker has drained it
+	Synchronize();
+	mpWorker->Stop();
+	SAFE_DELETE(mpWorker);
+
+	mDroppedBefore += queue->GetDroppedCount();
+	SAFE_DELETE(queue);
+}
+
+ULong Logger::GetDroppedCount() const
+{
+	std::lock_guard<std::mutex> lock(mWriterMutex);
+
+	LogQueue* queue = mpQueue.load(std::memory_order_acquire);
+	return mDroppedBefore + ( queue ? queue->GetDroppedCount() : 0 );
+}
+
+bool ErrorMessenger::Log(const LogEntry& entry)
 {
 	if (entry.level >= LogLevel::ERROR_LOG)
 	{
 		//display error box
 		return false;
 	}
+
+	return true;
 }
 
-LogFileWriter::LogFileWriter(String logFileName)
+LogFileWriter::LogFileWriter(String logFileName, LogFormat format)
+	: mFormat(format), mpLogFile(new klib::io::TextFile())
 {
-	if (logFile.Open(logFileName, klib::io::FileModes::Append))
-	{
-		logFile.Seek(logFile.GetSize());
-	}
-	else
+	klib::io::FileMode mode = klib::io::FileModes::Append;
+	if (format == LOG_FORMAT_BINARY)
+		mode |= klib::io::FileModes::Binary;
+
+	// Append mode already writes at the end of the file, no need to seek there
+	if (!mpLogFile->Open(logFileName, mode))
 	{
 		KL_FATAL("Logging file could not be opened or created");
 	}
@@ -51,14 +386,26 @@ LogFileWriter::LogFileWriter(String logFileName)
 
 LogFileWriter::~LogFileWriter(void)
 {
-	logFile.Close();
+	mpLogFile->Close();
+	SAFE_DELETE(mpLogFile);
+}
+
+bool LogFileWriter::Log(const LogEntry& entry)
+{
+	return LogBatch(&entry, 1);
 }
 
-bool LogFileWriter::Log(LogEntry entry)
+bool LogFileWriter::LogBatch(const LogEntry* entries, UInt count)
 {
-	//TODO Async
-	logFile.Write(entry.ToString());
-	logFile.Flush();
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// One write and one flush for the whole batch, the String keeps its capacity between batches
+	mText.clear();
+	for (UInt i = 0; i < count; i++)
+		entries[i].Format(mText, mFormat);
+
+	mpLogFile->Write(mText);
+	mpLogFile->Flush();
 
 	return true;
 }
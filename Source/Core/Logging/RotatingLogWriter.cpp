@@ -0,0 +1,330 @@
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <dirent.h>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <KLib/Time.hpp>
+#include <KLib/File.hpp>
+#include <KLib/FileSystem.hpp>
+#include <KLib/LogCompressor.hpp>
+#include <KLib/RotatingLogWriter.hpp>
+
+namespace klib
+{
+namespace logging
+{
+
+namespace priv
+{
+
+// A file preallocated to a fixed size and mapped for writing
+class MappedSegment
+{
+public:
+	MappedSegment() : mpData(nullptr), mSize(0)
+	{
+#ifdef _WIN32
+		mFile = INVALID_HANDLE_VALUE;
+		mMapping = NULL;
+#else
+		mFile = -1;
+#endif
+	}
+
+	~MappedSegment()
+	{
+		Close(mSize);
+	}
+
+	bool Open(const String& path, ULong size)
+	{
+#ifdef _WIN32
+		mFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (mFile == INVALID_HANDLE_VALUE)
+			return false;
+
+		// Mapping a file larger than it is extends it to the full size
+		mMapping = CreateFileMappingA(mFile, NULL, PAGE_READWRITE, (DWORD)( size >> 32 ), (DWORD)( size & 0xFFFFFFFF ), NULL);
+		if (mMapping == NULL)
+			return false;
+
+		mpData = static_cast<char*>( MapViewOfFile(mMapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)size) );
+#else
+		mFile = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (mFile < 0)
+			return false;
+
+		// Reserve the blocks now, so writing into the mapping can't hit a full disk later.
+		// A sparse file instead would raise SIGBUS on the first write once the disk is full.
+		if (posix_fallocate(mFile, 0, (off_t)size) != 0)
+			return false;
+
+		void* data = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+		mpData = ( data == MAP_FAILED ) ? nullptr : static_cast<char*>( data );
+#endif
+		mSize = size;
+		return mpData != nullptr;
+	}
+
+	// Unmaps and trims the file to 'used' bytes
+	void Close(ULong used)
+	{
+#ifdef _WIN32
+		if (mpData)
+			UnmapViewOfFile(mpData);
+		if (mMapping != NULL)
+			CloseHandle(mMapping);
+		if (mFile != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER end;
+			end.QuadPart = (LONGLONG)used;
+			SetFilePointerEx(mFile, end, NULL, FILE_BEGIN);
+			SetEndOfFile(mFile);
+			CloseHandle(mFile);
+		}
+		mMapping = NULL;
+		mFile = INVALID_HANDLE_VALUE;
+#else
+		if (mpData)
+			munmap(mpData, (size_t)mSize);
+		if (mFile >= 0)
+		{
+			if (ftruncate(mFile, (off_t)used) != 0)
+				KL_WARNING("Could not trim log segment");
+			close(mFile);
+		}
+		mFile = -1;
+#endif
+		mpData = nullptr;
+	}
+
+	void Sync()
+	{
+		if (!mpData)
+			return;
+#ifdef _WIN32
+		FlushViewOfFile(mpData, 0);
+#else
+		msync(mpData, (size_t)mSize, MS_ASYNC);
+#endif
+	}
+
+	inline char* GetData() const
+	{
+		return mpData;
+	}
+
+private:
+	char* mpData;
+	ULong mSize;
+#ifdef _WIN32
+	HANDLE mFile;
+	HANDLE mMapping;
+#else
+	int mFile;
+#endif
+};
+
+// Names of the entries in a directory, empty if it can't be read
+ArrayList<String> ListDirectory(const String& directory)
+{
+#ifdef _WIN32
+	return filesystem::Dir::Read(directory);
+#else
+	ArrayList<String> entries;
+
+	DIR* dir = opendir(directory.c_str());
+	if (!dir)
+		return entries;
+
+	while (dirent* entry = readdir(dir))
+		entries.push_back(entry->d_name);
+
+	closedir(dir);
+	return entries;
+#endif
+}
+
+// Indices of the segments of 'basePath' on disk, compressed or not, in ascending order.
+// Retention deletes the lowest ones, so the surviving indices rarely start at 0.
+ArrayList<UInt> FindSegments(const String& basePath)
+{
+	size_t slash = basePath.find_last_of("/\\");
+	String directory = ( slash == String::npos ) ? "." : ( slash == 0 ? "/" : basePath.substr(0, slash) );
+	String prefix = ( slash == String::npos ? basePath : basePath.substr(slash + 1) ) + ".";
+	String extension = LogCompressor::Extension;
+
+	ArrayList<UInt> indices;
+	for (const String& entry : ListDirectory(directory))
+	{
+		if (entry.size() <= prefix.size() || entry.compare(0, prefix.size(), prefix) != 0)
+			continue;
+
+		String number = entry.substr(prefix.size());
+		if (number.size() > extension.size() && number.compare(number.size() - extension.size(), extension.size(), extension) == 0)
+			number.resize(number.size() - extension.size());
+
+		if (number.empty() || number.size() > 9 || number.find_first_not_of("0123456789") != String::npos)
+			continue;
+
+		indices.push_back(static_cast<UInt>( std::stoul(number) ));
+	}
+
+	// A segment and its compressed copy share an index
+	std::sort(indices.begin(), indices.end());
+	indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+	return indices;
+}
+
+} // priv
+
+RotatingLogWriter::RotatingLogWriter(String basePath, ULong segmentSize, UInt keepSegments, ULong rolloverSeconds, LogFormat format)
+	: mBasePath(basePath), mSegmentSize(segmentSize), mKeepSegments(keepSegments), mRolloverSeconds(rolloverSeconds),
+	mFormat(format), mpSegment(nullptr), mOffset(0), mSegmentStarted(0), mNextIndex(0)
+{
+	// Carry on numbering after the segments of previous runs, they count towards keepSegments
+	ArrayList<UInt> existing = priv::FindSegments(mBasePath);
+	for (UInt index : existing)
+		mSegments.push_back(index);
+	if (!existing.empty())
+		mNextIndex = existing.back() + 1;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!OpenSegment())
+		KL_ERROR("Log segment '" + GetPath(mNextIndex - 1) + "' could not be created");
+}
+
+RotatingLogWriter::~RotatingLogWriter(void)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	CloseSegment();
+}
+
+bool RotatingLogWriter::Log(const LogEntry& entry)
+{
+	return LogBatch(&entry, 1);
+}
+
+bool RotatingLogWriter::LogBatch(const LogEntry* entries, UInt count)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (mRolloverSeconds > 0 && mpSegment &&
+		time::GetCurrentTime<time::seconds>() - mSegmentStarted >= mRolloverSeconds)
+	{
+		CloseSegment();
+		OpenSegment();
+	}
+
+	for (UInt i = 0; i < count; i++)
+	{
+		if (!mpSegment)
+			return true;
+
+		mText.clear();
+		entries[i].Format(mText, mFormat);
+
+		// Entries bigger than a whole segment are cut short
+		ULong size = std::min<ULong>(mText.size(), mSegmentSize);
+
+		if (mOffset + size > mSegmentSize)
+		{
+			CloseSegment();
+			if (!OpenSegment())
+				return true;
+		}
+
+		std::memcpy(mpSegment->GetData() + mOffset, mText.data(), (size_t)size);
+		mOffset += size;
+	}
+
+	return true;
+}
+
+bool RotatingLogWriter::Rotate()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	CloseSegment();
+	return OpenSegment();
+}
+
+void RotatingLogWriter::Flush()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mpSegment)
+		mpSegment->Sync();
+}
+
+bool RotatingLogWriter::IsOpen() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mpSegment != nullptr;
+}
+
+void RotatingLogWriter::SetCompressor(StrongPtr<LogCompressor> compressor)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mCompressor = compressor;
+}
+
+String RotatingLogWriter::GetSegmentPath() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mpSegment ? GetPath(mSegments.back()) : String();
+}
+
+bool RotatingLogWriter::OpenSegment()
+{
+	UInt index = mNextIndex++;
+
+	mpSegment = new priv::MappedSegment();
+	if (!mpSegment->Open(GetPath(index), mSegmentSize))
+	{
+		SAFE_DELETE(mpSegment);
+		return false;
+	}
+
+	mOffset = 0;
+	mSegmentStarted = time::GetCurrentTime<time::seconds>();
+	mSegments.push_back(index);
+
+	// Drop the oldest segments past the limit
+	while (mKeepSegments > 0 && mSegments.size() > mKeepSegments)
+	{
+		std::remove(GetPath(mSegments.front()).c_str());
+		std::remove(( GetPath(mSegments.front()) + LogCompressor::Extension ).c_str());
+		mSegments.pop_front();
+	}
+
+	return true;
+}
+
+void RotatingLogWriter::CloseSegment()
+{
+	if (!mpSegment)
+		return;
+
+	mpSegment->Close(mOffset);
+	SAFE_DELETE(mpSegment);
+
+	if (mCompressor)
+		mCompressor->Compress(GetPath(mSegments.back()));
+}
+
+String RotatingLogWriter::GetPath(UInt index) const
+{
+	return mBasePath + "." + klib::ToString(index);
+}
+
+} // logging
+} // klib
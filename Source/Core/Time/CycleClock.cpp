@@ -0,0 +1,114 @@
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include <KLib/CycleClock.hpp>
+
+namespace klib
+{
+namespace time
+{
+
+namespace priv
+{
+
+struct Calibration
+{
+	std::atomic<ULong> ticks; // Point both clocks were read at
+	std::atomic<ULong> nanoseconds;
+	std::atomic<double> nanosecondsPerTick;
+};
+
+// Written alternately, readers use the one g_currentCalibration points at.
+// With at most one calibration per second a reader is never caught in the middle of a write.
+Calibration g_calibrations[2];
+std::atomic<UInt> g_currentCalibration(0);
+
+std::mutex g_calibrationMutex;
+ULong g_originTicks = 0; // First calibration point, the rate is measured from here
+ULong g_originNanoseconds = 0;
+
+const ULong g_calibrationInterval = 1000000000ULL; // Nanoseconds
+
+inline ULong GetSystemNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Reads both clocks as close together as possible
+inline void Sample(ULong& ticks, ULong& nanoseconds)
+{
+	ULong before = CycleClock::Now();
+	nanoseconds = GetSystemNanoseconds();
+	ULong after = CycleClock::Now();
+	ticks = before + ( after - before ) / 2;
+}
+
+} // priv
+
+std::atomic<ULong> CycleClock::mNextCalibration(0);
+
+void CycleClock::Calibrate()
+{
+	std::lock_guard<std::mutex> lock(priv::g_calibrationMutex);
+
+	ULong next = mNextCalibration.load(std::memory_order_relaxed);
+	if (next != 0 && static_cast<Long>( Now() - next ) < 0)
+		return; // Another thread just did it
+
+	UInt current = priv::g_currentCalibration.load(std::memory_order_relaxed);
+	double rate = priv::g_calibrations[current].nanosecondsPerTick.load(std::memory_order_relaxed);
+
+	ULong ticks, nanoseconds;
+
+	if (next == 0)
+	{
+		priv::Sample(priv::g_originTicks, priv::g_originNanoseconds);
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		priv::Sample(ticks, nanoseconds);
+
+		rate = double( nanoseconds - priv::g_originNanoseconds ) / double( ticks - priv::g_originTicks );
+	}
+	else
+	{
+		priv::Sample(ticks, nanoseconds);
+
+		double measured = double( static_cast<Long>( nanoseconds - priv::g_originNanoseconds ) ) / double( ticks - priv::g_originTicks );
+		if (measured > rate * 0.99 && measured < rate * 1.01)
+		{
+			rate = measured;
+		}
+		else
+		{
+			// The system clock was stepped, keep the rate and measure again from here
+			priv::g_originTicks = ticks;
+			priv::g_originNanoseconds = nanoseconds;
+		}
+	}
+
+	priv::Calibration& calibration = priv::g_calibrations[current ^ 1];
+	calibration.ticks.store(ticks, std::memory_order_relaxed);
+	calibration.nanoseconds.store(nanoseconds, std::memory_order_relaxed);
+	calibration.nanosecondsPerTick.store(rate, std::memory_order_relaxed);
+	priv::g_currentCalibration.store(current ^ 1, std::memory_order_release);
+
+	mNextCalibration.store(ticks + static_cast<ULong>( priv::g_calibrationInterval / rate ), std::memory_order_relaxed);
+}
+
+ULong CycleClock::ToNanoseconds(ULong ticks)
+{
+	const priv::Calibration& calibration = priv::g_calibrations[priv::g_currentCalibration.load(std::memory_order_acquire)];
+
+	double rate = calibration.nanosecondsPerTick.load(std::memory_order_relaxed);
+	if (rate == 0.0)
+		return 0;
+
+	// Signed, entries stamped before the calibration point are common
+	Long elapsed = static_cast<Long>( ticks - calibration.ticks.load(std::memory_order_relaxed) );
+	return calibration.nanoseconds.load(std::memory_order_relaxed) + static_cast<Long>( elapsed * rate );
+}
+
+} // time
+} // klib
@@ -0,0 +1,37 @@
+#include <iostream>
+
+#include <KLib/BinaryLog.hpp>
+
+using namespace klib;
+
+// Turns a binary log written by BinaryLogger (KL_BINLOG) into text,
+// one LogEntry::ToString line per record.
+//
+// Usage: KLib-LogDecoder <binary log> [level]
+// Records below 'level' (0 = debug ... 4 = fatal) are skipped.
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <binary log> [level]" << std::endl;
+		return 1;
+	}
+
+	Int minimumLevel = ( argc > 2 ) ? FromString<Int>(argv[2]) : 0;
+
+	logging::BinaryLogReader reader;
+	if (!reader.Open(argv[1]))
+	{
+		std::cerr << "Could not read binary log '" << argv[1] << "'" << std::endl;
+		return 1;
+	}
+
+	logging::LogEntry entry;
+	while (reader.Next(entry))
+	{
+		if (entry.level >= minimumLevel)
+			std::cout << entry.ToString() << '\n';
+	}
+
+	return 0;
+}
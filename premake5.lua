@@ -20,6 +20,17 @@ newaction {
 	end
 }
 
+newoption {
+	trigger = "log-min-level",
+	value = "LEVEL",
+	description = "Strip log macros below this level at compile time (0 = debug ... 4 = fatal)"
+}
+
+newoption {
+	trigger = "no-io-uring",
+	description = "Never use io_uring for AsyncFile, always the worker thread fallback"
+}
+
 newaction {
 	trigger = "gen-docs",
 	description = "Generate documentation",
@@ -132,12 +143,21 @@ solution "ALL_BUILD"
 
 	configuration "linux"
 		defines { "LINUX", "__OS=\"Linux\"" }
+		defines { "_FILE_OFFSET_BITS=64" } --64-bit off_t/stat on x32 too, files over 4GB
 		
 	configuration "x32"
 		vectorextensions "SSE2" --Enable SSE2 cpu extensions
 		--vectorextensions "AVX" --Enable AXV cpu extensions; 2011+ Bulldozer/Sandy Bridge
 	
 	configuration {}
+
+	if _OPTIONS["log-min-level"] then
+		defines { "KL_LOG_MIN_LEVEL=" .. _OPTIONS["log-min-level"] }
+	end
+
+	if _OPTIONS["no-io-uring"] then
+		defines { "KL_NO_IO_URING" }
+	end
 		
 	targetdir( "Lib" ) --put it in lib instead..
 	location( "Build" )
@@ -156,5 +176,26 @@ project "KLib-Core"
 	warnings "Extra" --Enable extra warnings. Warnings shouldn't exist
 	
 	suffix_macro ( nil, true )
+
+project "KLib-LogDecoder"
+	language "C++"
+	files { "Tools/LogDecoder/**.cpp" }
+
+	includedirs { "Include" }
+
+	kind ("ConsoleApp") --decodes KL_BINLOG files offline
+	links { "KLib-Core" }
+
+	configMacro()
+
+	configuration "linux"
+		links { "pthread" }
+
+	configuration {}
+
+	warnings "Extra"
+
+	targetdir( "Bin" )
+	suffix_macro ( nil, true )
 	
 end --if action == clean, clean-all, version; else.
\ No newline at end of file